@@ -249,6 +249,17 @@ static inline void raise_interrupt(Core* core, Interrupt intno)
 }
 
 
+/*
+	Return 1 if an interrupt is pending for the given core.
+ */
+static inline int core_interrupt_pending(Core* core)
+{
+	for(int intno = 0; intno < maximum_interrupt_no; intno++)
+		if(core->intpending[intno]) return 1;
+	return 0;
+}
+
+
 /*
 	Dispatch the pending iterrupts for the given core.
  */
@@ -739,10 +750,14 @@ void cpu_core_halt()
 	assert(! core->int_disabled);
 	CHECKRC(pthread_sigmask(SIG_BLOCK, &sigusr1_set, NULL));
 	pthread_mutex_lock(& core_halt_mutex);
-	core->halted = 1;
-	rlist_push_front(&halted_list, & core->halted_node);
-	while(core->halted)
-		pthread_cond_wait(& core->halt_cond, & core_halt_mutex);
+	/* An interrupt raised after we blocked SIGUSR1 found us running, 
+	   so it will not restart us. Do not halt, dispatch it. */
+	if(! core_interrupt_pending(core)) {
+		core->halted = 1;
+		rlist_push_front(&halted_list, & core->halted_node);
+		while(core->halted)
+			pthread_cond_wait(& core->halt_cond, & core_halt_mutex);
+	}
 	assert(! core->halted);
 	pthread_mutex_unlock(& core_halt_mutex);
 	CHECKRC(pthread_sigmask(SIG_UNBLOCK, &sigusr1_set, NULL));
@@ -874,7 +889,11 @@ TimerDuration bios_cancel_timer()
 
 TimerDuration bios_clock()
 {
-	return system_clock * 1000ul;
+	/* The coarse clock is only refreshed every SLOW_HZ usec, read the real one.
+	   Deadlines and usage are measured with it, so it must not jump */
+	struct timespec curtime;
+	CHECK(clock_gettime(CLOCK_MONOTONIC, &curtime));
+	return curtime.tv_sec*1000000ul + curtime.tv_nsec/1000;
 }	
 
 
@@ -301,10 +301,8 @@ void cpu_swap_context(cpu_context_t* oldctx, cpu_context_t* newctx);
 /** 
 	@brief Reset the core timer to the specified interval.
 
-	The interval for the timer is given in microseconds, but the 
-	accuracy of the alarm is much coarser, to the order of 10 msec
-	(that is, 10,000 microseconds). After the interval expires, the
-	core receives an ALARM interrupt.
+	The interval for the timer is given in microseconds. After the 
+	interval expires, the core receives an ALARM interrupt.
 
 	This function can be called even if the timer is already activated;
 	in this case, the previous timer countdown is canceled and the timer resets
@@ -332,13 +330,10 @@ TimerDuration bios_cancel_timer();
 /**
 	@brief Get the current time from the hardware clock.
 
-	This function returns a real-time clock value, in usec.
-	The value of the clock is 10 times the number of seconds since
-	the epoch. 
-
-	The resolution of the clock is very low, currently 
-	around 100 msec. Therefore, it is inappropriate for any type of
-	precise timing.
+	This function returns a monotonic clock value, in usec
+	since an arbitrary point in the past, with a resolution of 1 usec.
+	It is not affected by changes to the system time, so it is 
+	only meaningful for measuring intervals and deadlines.
  */
 TimerDuration bios_clock();
 
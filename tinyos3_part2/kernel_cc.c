@@ -110,6 +110,8 @@ static inline void remove_from_ring(CondVar* cv, __cv_waiter* w)
   @param cv The condition variable to sleep on.
   @param cause A cause provided to the kernel scheduler.
   @param timeout The time to sleep, or @c NO_TIMEOUT to sleep for ever.
+  @param event If not NULL, the thread does not sleep if @c *event is set
+     once it has joined the waiters. 
 
   @returns 1 if this thread was woken up by signal/broadcast, 0 otherwise
 
@@ -117,7 +119,8 @@ static inline void remove_from_ring(CondVar* cv, __cv_waiter* w)
   @see Cond_Broadcast
   */
 static int cv_wait(Mutex* mutex, CondVar* cv, 
-		enum SCHED_CAUSE cause, TimerDuration timeout)
+		enum SCHED_CAUSE cause, TimerDuration timeout, 
+		volatile sig_atomic_t* event)
 {
 	__cv_waiter waiter = { .thread=CURTHREAD, .signalled = 0, .removed=0 };
 	rlnode_init(& waiter.node, &waiter);
@@ -131,6 +134,13 @@ static int cv_wait(Mutex* mutex, CondVar* cv,
 		cv->waitset = &waiter;
 	}
 
+	/* An event set before we joined the ring did not signal us */
+	if(event != NULL && *event) {
+		remove_from_ring(cv, &waiter);
+		Mutex_Unlock(&(cv->waitset_lock));
+		return 1;
+	}
+
 	/* Now atomically release mutex and sleep */
 	Mutex_Unlock(mutex);
 	sleep_releasing(STOPPED, &(cv->waitset_lock), cause, timeout);
@@ -174,13 +184,13 @@ static inline void cv_signal(CondVar* cv)
 
 int Cond_Wait(Mutex* mutex, CondVar* cv)
 {
-	return cv_wait(mutex, cv, SCHED_USER, NO_TIMEOUT);
+	return cv_wait(mutex, cv, SCHED_USER, NO_TIMEOUT, NULL);
 }
 
 int Cond_TimedWait(Mutex* mutex, CondVar* cv, timeout_t timeout)
 {
 	/* We have to translate timeout from msec to usec */
-	return cv_wait(mutex, cv, SCHED_USER, timeout*1000ul);
+	return cv_wait(mutex, cv, SCHED_USER, timeout*1000ul, NULL);
 }
 
 
@@ -269,15 +279,16 @@ void kernel_unlock()
 	Mutex_Unlock(& kernel_mutex);
 }
 
-int kernel_wait_wchan(CondVar* cv, enum SCHED_CAUSE cause, 
-	const char* wchan_name, TimerDuration timeout)
+/* Release the kernel semaphore, wait on cv and reacquire it */
+static int kernel_cv_wait(CondVar* cv, enum SCHED_CAUSE cause, 
+	TimerDuration timeout, volatile sig_atomic_t* event)
 {
 	/* Atomically release kernel semaphore */
 	Mutex_Lock(& kernel_mutex);
 	kernel_sem++;
 	Cond_Signal(&kernel_sem_cv);	
 
-	int ret = cv_wait(&kernel_mutex, cv, cause, timeout);
+	int ret = cv_wait(&kernel_mutex, cv, cause, timeout, event);
 
 	/* Reacquire kernel semaphore */
 	while(kernel_sem<=0)
@@ -288,6 +299,23 @@ int kernel_wait_wchan(CondVar* cv, enum SCHED_CAUSE cause,
 	return ret;
 }
 
+int kernel_wait_wchan(CondVar* cv, enum SCHED_CAUSE cause, 
+	const char* wchan_name, TimerDuration timeout)
+{
+	return kernel_cv_wait(cv, cause, timeout, NULL);
+}
+
+int kernel_wait_event(CondVar* cv, volatile sig_atomic_t* event, 
+	enum SCHED_CAUSE cause, TimerDuration timeout)
+{
+	/* The handlers that set the event cannot interrupt us 
+	   while we hold the lock of cv */
+	int preempt = preempt_off;
+	int ret = kernel_cv_wait(cv, cause, timeout, event);
+	if(preempt) preempt_on;
+	return ret;
+}
+
 void kernel_signal(CondVar* cv) 
 { 
 	Cond_Signal(cv); 
@@ -59,6 +59,20 @@ int kernel_wait_wchan(CondVar* cv, enum SCHED_CAUSE cause,
 #define kernel_timedwait(cv, cause, timeout) \
 	kernel_wait_wchan((cv),(cause),__FUNCTION__, (timeout))
 
+/**
+	@brief Wait for an event that is set by an interrupt handler.
+
+	The handler sets @c *event and then broadcasts @c cv. The thread
+	does not sleep if @c *event is already set when it joins the waiters
+	of @c cv, so the wakeup cannot be lost between a check of the event
+	and the sleep. The wait runs with preemption off, so that the handler
+	does not spin on the lock of @c cv while this thread holds it.
+
+	@returns 1 if signalled or the event was set, 0 if not
+  */
+int kernel_wait_event(CondVar* cv, volatile sig_atomic_t* event, 
+	enum SCHED_CAUSE cause, TimerDuration timeout);
+
 /**
 	@brief Signal a kernel condition to one waiter.
 
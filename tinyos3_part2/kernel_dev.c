@@ -15,6 +15,70 @@
 DCB DT[MAX_TERMINALS];
 
 
+/* ===================================
+
+  Poll hooks
+
+  ====================================*/
+
+void poll_hook_init(poll_hook* hook, void (*notify)(poll_hook*), void* data)
+{
+  for(int i=0; i<POLL_HOOK_LISTS; i++)
+    rlnode_init(& hook->node[i], hook);
+  hook->nlists = 0;
+  hook->notify = notify;
+  hook->data = data;
+}
+
+void poll_hook_attach(poll_hook* hook, rlnode* list, Mutex* lock)
+{
+  assert(hook->nlists < POLL_HOOK_LISTS);
+  unsigned int i = hook->nlists++;
+  hook->lock[i] = lock;
+
+  if(lock) {
+    int pre = preempt_off;
+    Mutex_Lock(lock);
+    rlist_push_back(list, & hook->node[i]);
+    Mutex_Unlock(lock);
+    if(pre) preempt_on;
+  }
+  else
+    rlist_push_back(list, & hook->node[i]);
+}
+
+void poll_hook_detach(poll_hook* hook)
+{
+  for(unsigned int i=0; i<hook->nlists; i++) {
+    if(hook->lock[i]) {
+      int pre = preempt_off;
+      Mutex_Lock(hook->lock[i]);
+      rlist_remove(& hook->node[i]);
+      Mutex_Unlock(hook->lock[i]);
+      if(pre) preempt_on;
+    }
+    else
+      rlist_remove(& hook->node[i]);
+  }
+  hook->nlists = 0;
+}
+
+void poll_notify(rlnode* list)
+{
+  for(rlnode* n = list->next; n != list; n = n->next) {
+    poll_hook* hook = n->obj;
+    hook->notify(hook);
+  }
+}
+
+void poll_list_clear(rlnode* list)
+{
+  /* Removed nodes are left pointing to themselves, so a later detach does nothing */
+  while(! is_rlist_empty(list))
+    rlist_pop_front(list);
+}
+
+
 /* ===================================
 
   The null device driver
@@ -68,8 +132,11 @@ void serial_tx_handler();
 
 typedef struct serial_device_control_block {
   uint devno;
-  Mutex spinlock;
+  Mutex spinlock;         /* Protects the poll list and the read-ahead byte */
   CondVar rx_ready;
+  rlnode pollers;         /* The poll list, notified by the interrupt handler */
+  int has_peek;           /* A byte was read by serial_poll, ahead of serial_read */
+  char peek;
 } serial_dcb_t;
 
 serial_dcb_t serial_dcb[MAX_TERMINALS];
@@ -91,10 +158,33 @@ void serial_rx_handler()
   for(int i=0;i<bios_serial_ports();i++) {
     serial_dcb_t* dcb = &serial_dcb[i];
     Cond_Broadcast(&dcb->rx_ready);
+
+    Mutex_Lock(&dcb->spinlock);
+    poll_notify(&dcb->pollers);
+    Mutex_Unlock(&dcb->spinlock);
   }
   if(pre) preempt_on;
 }
 
+/*
+  Take the next input byte: the one read ahead by serial_poll, if any,
+  else one from the device. Returns 1 if a byte was taken.
+  Must be called with preemption off.
+ */
+static int serial_getc(serial_dcb_t* dcb, char* c)
+{
+  Mutex_Lock(&dcb->spinlock);
+  int valid = dcb->has_peek;
+  if(valid) {
+    *c = dcb->peek;
+    dcb->has_peek = 0;
+  }
+  else
+    valid = bios_read_serial(dcb->devno, c);
+  Mutex_Unlock(&dcb->spinlock);
+  return valid;
+}
+
 /*
   Read from the device, sleeping if needed.
  */
@@ -106,8 +196,10 @@ int serial_read(void* dev, char *buf, unsigned int size)
 
   uint count =  0;
 
+  /* A poll may read ahead while we sleep, so serial_getc checks for it 
+     before every device read */
   while(count<size) {
-    int valid = bios_read_serial(dcb->devno, &buf[count]);
+    int valid = serial_getc(dcb, &buf[count]);
     
     if (valid) {
       count++;
@@ -168,6 +260,29 @@ int serial_close(void* dev)
 }
 
 
+/*
+  Poll call. The device cannot tell if there is input without taking it, 
+  so a byte is read ahead and kept for the next read.
+*/
+int serial_poll(void* dev, poll_hook* hook)
+{
+  serial_dcb_t* dcb = (serial_dcb_t*)dev;
+
+  if(hook)
+    poll_hook_attach(hook, &dcb->pollers, &dcb->spinlock);
+
+  int pre = preempt_off;
+  Mutex_Lock(&dcb->spinlock);
+  if(! dcb->has_peek)
+    dcb->has_peek = bios_read_serial(dcb->devno, &dcb->peek);
+  int readable = dcb->has_peek;
+  Mutex_Unlock(&dcb->spinlock);
+  if(pre) preempt_on;
+
+  return (readable ? POLL_READ : 0) | POLL_WRITE;
+}
+
+
 void* serial_open(uint term)
 {
   assert(term<bios_serial_ports());
@@ -180,7 +295,8 @@ file_ops serial_fops = {
   .Open = serial_open,
   .Read = serial_read,
   .Write = serial_write,
-  .Close = serial_close
+  .Close = serial_close,
+  .Poll = serial_poll
 };
 
 
@@ -211,6 +327,8 @@ void initialize_devices()
     serial_dcb[i].devno = i;
     serial_dcb[i].rx_ready = COND_INIT;
     serial_dcb[i].spinlock = MUTEX_INIT;
+    rlnode_init(& serial_dcb[i].pollers, NULL);
+    serial_dcb[i].has_peek = 0;
   }
 
   cpu_interrupt_handler(SERIAL_RX_READY, serial_rx_handler);
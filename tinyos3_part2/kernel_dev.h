@@ -34,6 +34,45 @@
 */
 
 
+/** @brief The number of poll lists a hook can be on */
+#define POLL_HOOK_LISTS 2
+
+/**
+  @brief A hook for the changes of a stream.
+
+  A hook is attached by the @c Poll method of a stream to the poll lists 
+  of the stream object. When the state of the object may have changed, 
+  the object calls @c poll_notify on its list, which calls the @c notify
+  function of each hook there. 
+
+  A poll list is protected either by the kernel lock, or, if it is changed 
+  by interrupt handlers, by a spinlock. In the latter case, @c notify may 
+  be called from an interrupt handler, so it must not block.
+  */
+typedef struct poll_hook {
+  rlnode node[POLL_HOOK_LISTS];   /**< @brief The nodes in the poll lists */
+  Mutex* lock[POLL_HOOK_LISTS];   /**< @brief The spinlock of each list, or NULL for the kernel lock */
+  unsigned int nlists;            /**< @brief The number of lists the hook is on */
+  void (*notify)(struct poll_hook* hook);  /**< @brief Called on a change of the stream */
+  void* data;                     /**< @brief Data for @c notify */
+} poll_hook;
+
+/** @brief Initialize a hook, which is on no list */
+void poll_hook_init(poll_hook* hook, void (*notify)(poll_hook*), void* data);
+
+/** @brief Attach a hook to a poll list, protected by @c lock, or the kernel lock if @c lock is NULL */
+void poll_hook_attach(poll_hook* hook, rlnode* list, Mutex* lock);
+
+/** @brief Remove a hook from all its lists */
+void poll_hook_detach(poll_hook* hook);
+
+/** @brief Call the hooks on a poll list. The lock of the list must be held */
+void poll_notify(rlnode* list);
+
+/** @brief Remove all hooks from a poll list, before the list is freed */
+void poll_list_clear(rlnode* list);
+
+
 /**
   @brief The device-specific file operations table.
 
@@ -92,6 +131,52 @@ typedef struct file_operations {
     - There was a I/O runtime problem.
      */
     int (*Close)(void* this);
+
+    /** @brief Set the low-water mark for reading.
+
+      After this call, a Read returns when at least 'lowat' bytes 
+      (or 'size', if smaller) are available, or at end of data.
+      This method is optional. It returns 0 on success and -1 on error.
+     */
+    int (*SetLowWater)(void* this, unsigned int lowat);
+
+    /** @brief Return the pipe buffer behind the stream.
+
+      Streams whose data is kept in a pipe buffer return it, so that
+      the kernel can move data between pipe buffers directly.
+      If 'write' is 1, the pipe written by the stream is returned,
+      else the pipe read by the stream. If there is no such pipe,
+      NULL is returned. This method is optional.
+     */
+    void* (*GetPipe)(void* this, int write);
+
+    /** @brief Vectored read operation.
+
+      Read into the 'iovcnt' buffers of 'iov', as 'Read' would read into
+      a single buffer made of them. The return value is as for 'Read'.
+      This method is optional. Without it, 'ReadV' calls 'Read' on each
+      buffer.
+     */
+    int (*ReadV)(void* this, const iovec_t* iov, unsigned int iovcnt);
+
+    /** @brief Vectored write operation.
+
+      Write the 'iovcnt' buffers of 'iov', as 'Write' would write a single 
+      buffer made of them. The return value is as for 'Write'.
+      This method is optional. Without it, 'WriteV' calls 'Write' on each
+      buffer.
+     */
+    int (*WriteV)(void* this, const iovec_t* iov, unsigned int iovcnt);
+
+    /** @brief Poll operation.
+
+      Return the events of the stream, a mask of @c POLL_READ, @c POLL_WRITE 
+      and @c POLL_HANGUP. If 'hook' is not NULL, also attach it to the poll
+      lists of the stream object, so that it is notified when the events 
+      may have changed. This method is optional. Without it, a stream is
+      always ready for reading and writing.
+     */
+    int (*Poll)(void* this, poll_hook* hook);
 } file_ops;
 
 
@@ -0,0 +1,164 @@
+
+#include "tinyos.h"
+#include "kernel_sched.h"
+#include "kernel_streams.h"
+#include "kernel_pipe.h"
+#include "kernel_dev.h"
+#include "kernel_cc.h"
+
+/*
+  An event counter is a 64-bit counter behind a file id. A Write adds to
+  it and a Read takes from it, under the kernel lock that every system
+  call holds, with no buffer to manage. Sleepers are counted, so that a
+  Write that nobody waits for does not touch a condition variable, and
+  the pollers are only notified when the counter becomes readable or
+  writable.
+*/
+
+/*The largest value of the counter*/
+#define EVENTFD_MAX (UINT64_MAX - 1)
+
+/*Event Counter Control Block*/
+typedef struct eventfd_control_block
+{
+	uint64_t count;           //the counter
+	int semaphore;            //reads take 1 at a time
+	FCB* fcb;                 //the stream, for its flags
+	unsigned int readers;     //the readers waiting for a non-zero counter
+	unsigned int writers;     //the writers waiting for room
+	CondVar nonzero, room;    //readers and writers sleep here
+	rlnode pollers;           //the poll list
+}EVENTFDCB;
+
+
+/*Take from the counter, waiting for it to be non-zero.
+Returns 8 on success, otherwise -1*/
+static int eventfd_read(void* this, char* buf, unsigned int size)
+{
+	EVENTFDCB* efd = (EVENTFDCB*)this;
+
+	if (size < sizeof(uint64_t))
+		return -1;
+
+	while (efd->count == 0){
+		if (FCB_nonblock(efd->fcb))
+			return WOULD_BLOCK;
+		efd->readers++;
+		stream_wait(& efd->nonzero, NO_TIMEOUT);
+		efd->readers--;
+	}
+
+	int was_full = (efd->count == EVENTFD_MAX);
+	uint64_t value = efd->semaphore ? 1 : efd->count;
+	efd->count -= value;
+	memcpy(buf, &value, sizeof(value));
+
+	if (efd->writers > 0)
+		kernel_broadcast(& efd->room);
+	if (was_full)
+		poll_notify(& efd->pollers);
+	return sizeof(uint64_t);
+}
+
+/*Add to the counter, waiting for room.
+Returns 8 on success, otherwise -1*/
+static int eventfd_write(void* this, const char* buf, unsigned int size)
+{
+	EVENTFDCB* efd = (EVENTFDCB*)this;
+
+	/*An empty write only checks that the stream is writable*/
+	if (size == 0)
+		return 0;
+
+	uint64_t value;
+	if (size < sizeof(uint64_t))
+		return -1;
+	memcpy(&value, buf, sizeof(value));
+	if (value > EVENTFD_MAX)
+		return -1;
+
+	while (value > EVENTFD_MAX - efd->count){
+		if (FCB_nonblock(efd->fcb))
+			return WOULD_BLOCK;
+		efd->writers++;
+		stream_wait(& efd->room, NO_TIMEOUT);
+		efd->writers--;
+	}
+
+	if (value == 0)
+		return sizeof(uint64_t);
+
+	int was_zero = (efd->count == 0);
+	efd->count += value;
+
+	/*One reader takes the whole count, a semaphore may feed several*/
+	if (efd->readers > 0){
+		if (efd->semaphore)
+			kernel_broadcast(& efd->nonzero);
+		else
+			kernel_signal(& efd->nonzero);
+	}
+	if (was_zero)
+		poll_notify(& efd->pollers);
+	return sizeof(uint64_t);
+}
+
+/*Return the events of the counter*/
+static int eventfd_poll(void* this, poll_hook* hook)
+{
+	EVENTFDCB* efd = (EVENTFDCB*)this;
+
+	if (hook != NULL)
+		poll_hook_attach(hook, & efd->pollers, NULL);
+	return ((efd->count > 0) ? POLL_READ : 0) | ((efd->count < EVENTFD_MAX) ? POLL_WRITE : 0);
+}
+
+/*Destroy the counter*/
+static int eventfd_close(void* this)
+{
+	EVENTFDCB* efd = (EVENTFDCB*)this;
+	poll_list_clear(& efd->pollers);
+	free(efd);
+	return 0;
+}
+
+/* The file operations of an event counter */
+static file_ops eventfdOps = {
+	.Open = NULL,
+	.Read = eventfd_read,
+	.Write = eventfd_write,
+	.Close = eventfd_close,
+	.Poll = eventfd_poll
+};
+
+
+Fid_t sys_EventFd(unsigned int initval, int flags)
+{
+	if ((flags & ~EVENTFD_SEMAPHORE) != 0)
+		return NOFILE;
+
+	EVENTFDCB* efd = (EVENTFDCB*)malloc(sizeof(EVENTFDCB));
+	if (efd == NULL)
+		return NOFILE;
+
+	Fid_t fid;
+	FCB* fcb;
+	if (FCB_reserve(1, &fid, &fcb) == 0){
+		free(efd);
+		return NOFILE;
+	}
+
+	efd->count = initval;
+	efd->semaphore = (flags & EVENTFD_SEMAPHORE) != 0;
+	efd->fcb = fcb;
+	efd->readers = 0;
+	efd->writers = 0;
+	efd->nonzero = COND_INIT;
+	efd->room = COND_INIT;
+	rlnode_init(& efd->pollers, NULL);
+
+	fcb->streamobj = efd;
+	fcb->streamfunc = &eventfdOps;
+	fcb->streamtype = STREAM_EVENTFD;
+	return fid;
+}
@@ -0,0 +1,278 @@
+
+#include "tinyos.h"
+#include "kernel_sched.h"
+#include "kernel_streams.h"
+#include "kernel_pipe.h"
+#include "kernel_dev.h"
+#include "kernel_cc.h"
+
+/*
+  An event set keeps an item for each registered stream. The item has a
+  poll hook on the stream, which pushes the item to the ready list of the
+  set when the stream changes. A wait takes the items off the ready list
+  and asks each stream for its events, so its cost depends on the ready
+  streams only.
+
+  The set does not hold the streams open. Each stream keeps a list of its
+  items, and when its last reference is dropped the items are removed, as
+  if by EVENT_DEL, before the stream is closed.
+
+  Terminals notify their hooks from the interrupt handler, so the ready
+  list is protected by a spinlock, and the waiters sleep on a condition
+  variable that can be signalled from interrupts.
+*/
+
+typedef struct evset_control_block EVSETCB;
+
+/*A registered stream*/
+typedef struct evset_item
+{
+	poll_hook hook;           //the hook on the stream
+	EVSETCB* evset;           //the event set
+	FCB* fcb;                 //the stream
+	Fid_t fd;                 //the file id it was registered with
+	int events;               //the events of interest
+	rlnode item_node;         //the node in the list of items
+	rlnode fcb_node;          //the node in the list of items of the stream
+	rlnode ready_node;        //the node in the ready list, a singleton if not ready
+}EVITEM;
+
+/*Event Set Control Block*/
+struct evset_control_block
+{
+	rlnode items;             //the registered streams
+	rlnode ready;             //the items that may be ready
+	Mutex spinlock;           //protects the ready list
+	volatile sig_atomic_t nonempty;  //the ready list is not empty, set under the spinlock
+	CondVar ready_cv;         //waiters sleep here
+};
+
+
+/*Push an item to the ready list, unless it is there already, and wake up the waiters*/
+static void evset_push_ready(EVITEM* item)
+{
+	EVSETCB* evset = item->evset;
+
+	int pre = preempt_off;
+	Mutex_Lock(& evset->spinlock);
+	if (item->ready_node.next == & item->ready_node)
+		rlist_push_back(& evset->ready, & item->ready_node);
+	evset->nonempty = 1;
+	Mutex_Unlock(& evset->spinlock);
+	if (pre) preempt_on;
+
+	Cond_Broadcast(& evset->ready_cv);
+}
+
+/*Pop the next ready item, or return NULL*/
+static EVITEM* evset_pop_ready(EVSETCB* evset)
+{
+	EVITEM* item = NULL;
+
+	int pre = preempt_off;
+	Mutex_Lock(& evset->spinlock);
+	if (! is_rlist_empty(& evset->ready))
+		item = rlist_pop_front(& evset->ready)->obj;
+	evset->nonempty = ! is_rlist_empty(& evset->ready);
+	Mutex_Unlock(& evset->spinlock);
+	if (pre) preempt_on;
+
+	return item;
+}
+
+/*The notify function of the hooks. It may run in an interrupt handler*/
+static void evset_notify(poll_hook* hook)
+{
+	EVITEM* item = (EVITEM*)hook->data;
+	evset_push_ready(item);
+}
+
+/*Return the events of interest of the stream of an item*/
+static int evset_item_events(EVITEM* item, poll_hook* hook)
+{
+	FCB* fcb = item->fcb;
+	return fcb->streamfunc->Poll(fcb->streamobj, hook) & (item->events | POLL_HANGUP);
+}
+
+/*Remove an item from the set and from its stream*/
+static void evset_remove(EVITEM* item)
+{
+	EVSETCB* evset = item->evset;
+
+	/*After the detach, the hook cannot be called again*/
+	poll_hook_detach(& item->hook);
+
+	int pre = preempt_off;
+	Mutex_Lock(& evset->spinlock);
+	rlist_remove(& item->ready_node);
+	evset->nonempty = ! is_rlist_empty(& evset->ready);
+	Mutex_Unlock(& evset->spinlock);
+	if (pre) preempt_on;
+
+	rlist_remove(& item->item_node);
+	rlist_remove(& item->fcb_node);
+	free(item);
+}
+
+void evset_forget(FCB* fcb)
+{
+	while (! is_rlist_empty(& fcb->evitems))
+		evset_remove(fcb->evitems.next->obj);
+}
+
+/*Destroy the set, with its registrations*/
+static int evset_close(void* this)
+{
+	EVSETCB* evset = (EVSETCB*)this;
+
+	while (! is_rlist_empty(& evset->items))
+		evset_remove(evset->items.next->obj);
+	free(evset);
+	return 0;
+}
+
+/* The file operations of an event set */
+static file_ops evsetOps = {
+	.Open = NULL,
+	.Close = evset_close
+};
+
+/*Return the set of a file id, or NULL if it is not an event set*/
+static EVSETCB* get_evset(Fid_t fd)
+{
+	FCB* fcb = get_fcb(fd);
+	if (fcb == NULL || fcb->streamfunc != &evsetOps)
+		return NULL;
+	return (EVSETCB*)fcb->streamobj;
+}
+
+/*Return the item of a stream, or NULL if it is not registered*/
+static EVITEM* evset_find(EVSETCB* evset, FCB* fcb)
+{
+	for (rlnode* n = evset->items.next; n != & evset->items; n = n->next){
+		EVITEM* item = n->obj;
+		if (item->fcb == fcb)
+			return item;
+	}
+	return NULL;
+}
+
+
+Fid_t sys_EventSet()
+{
+	EVSETCB* evset = (EVSETCB*)malloc(sizeof(EVSETCB));
+	if (evset == NULL)
+		return NOFILE;
+
+	Fid_t fid;
+	FCB* fcb;
+	if (FCB_reserve(1, &fid, &fcb) == 0){
+		free(evset);
+		return NOFILE;
+	}
+
+	rlnode_init(& evset->items, NULL);
+	rlnode_init(& evset->ready, NULL);
+	evset->spinlock = MUTEX_INIT;
+	evset->nonempty = 0;
+	evset->ready_cv = COND_INIT;
+
+	fcb->streamobj = evset;
+	fcb->streamfunc = &evsetOps;
+	fcb->streamtype = STREAM_EVSET;
+	return fid;
+}
+
+
+int sys_EventCtl(Fid_t evfd, event_op op, Fid_t fd, int events)
+{
+	EVSETCB* evset = get_evset(evfd);
+	FCB* fcb = get_fcb(fd);
+	if (evset == NULL || fcb == NULL || fcb->streamfunc->Poll == NULL)
+		return -1;
+
+	EVITEM* item = evset_find(evset, fcb);
+
+	switch (op){
+		case EVENT_ADD:
+			if (item != NULL)
+				return -1;
+			item = (EVITEM*)malloc(sizeof(EVITEM));
+			if (item == NULL)
+				return -1;
+			poll_hook_init(& item->hook, evset_notify, item);
+			item->evset = evset;
+			item->fcb = fcb;
+			item->fd = fd;
+			item->events = events;
+			rlnode_init(& item->item_node, item);
+			rlnode_init(& item->ready_node, item);
+			rlnode_init(& item->fcb_node, item);
+
+			rlist_push_back(& evset->items, & item->item_node);
+			rlist_push_back(& fcb->evitems, & item->fcb_node);
+			if (evset_item_events(item, & item->hook))
+				evset_push_ready(item);
+			return 0;
+
+		case EVENT_MOD:
+			if (item == NULL)
+				return -1;
+			item->events = events;
+			if (evset_item_events(item, NULL))
+				evset_push_ready(item);
+			return 0;
+
+		case EVENT_DEL:
+			if (item == NULL)
+				return -1;
+			evset_remove(item);
+			return 0;
+
+		default:
+			return -1;
+	}
+}
+
+
+int sys_EventWait(Fid_t evfd, event_t* events, unsigned int maxevents, timeout_t timeout)
+{
+	EVSETCB* evset = get_evset(evfd);
+	if (evset == NULL || events == NULL || maxevents == 0)
+		return -1;
+
+	/* make sure that the set will not be closed (by another thread)
+	   while we are using it! */
+	FCB* fcb = get_fcb(evfd);
+	FCB_incref(fcb);
+
+	TimerDuration deadline = timeout_deadline(timeout);
+	unsigned int count = 0;
+
+	while (1){
+		/*An item that changes after it is popped is pushed again,
+		  so no edge is lost. Items with no events left are dropped.
+		  The hook is attached again, since the poll lists of a stream
+		  may change with its state, e.g. when a socket connects*/
+		EVITEM* item;
+		while (count < maxevents && (item = evset_pop_ready(evset)) != NULL){
+			poll_hook_detach(& item->hook);
+			int ev = evset_item_events(item, & item->hook);
+			if (ev){
+				events[count].fd = item->fd;
+				events[count].events = ev;
+				count++;
+			}
+		}
+		if (count > 0)
+			break;
+
+		TimerDuration now = bios_clock();
+		if (timeout == 0 || (deadline != NO_TIMEOUT && now >= deadline))
+			break;
+		stream_wait_event(& evset->ready_cv, & evset->nonempty, (deadline == NO_TIMEOUT) ? NO_TIMEOUT : deadline - now);
+	}
+
+	FCB_decref(fcb);
+	return count;
+}
@@ -0,0 +1,227 @@
+
+#include "tinyos.h"
+#include "kernel_sched.h"
+#include "kernel_streams.h"
+#include "kernel_pipe.h"
+#include "kernel_proc.h"
+#include "kernel_cc.h"
+
+/*
+  A message queue keeps a list of messages for each priority, and a bitmap
+  of the non-empty lists, so that the next message is found in constant
+  time. Each message is copied once into a node of its own when it is
+  sent, and once out of it when it is received. A send wakes up one
+  receiver, and a receive wakes up one sender.
+*/
+
+/*A message in a queue*/
+typedef struct message_node
+{
+	rlnode node;              //the node in the list of its priority
+	unsigned int len;         //the size of the message
+	char data[];              //the message
+}MSGNODE;
+
+/*Message Queue Control Block*/
+typedef struct msgq_control_block
+{
+	rlnode queue[MSGQ_PRIORITIES];   //the messages of each priority, oldest first
+	uint32_t nonempty_prios;         //bit p is set if queue[p] is not empty
+	unsigned int count;              //the number of messages in the queue
+	unsigned int maxmsg;             //the maximum number of messages
+	unsigned int msgsize;            //the maximum size of a message
+	CondVar nonempty, nonfull;       //receivers wait for a message, senders for room
+	rlnode pollers;                  //the poll list
+}MSGQCB;
+
+_Static_assert(MSGQ_PRIORITIES <= 32, "The priority bitmap is 32 bits");
+
+
+/*Send a message, waiting for room in the queue.
+Returns 0 on success, otherwise -1*/
+static int msgq_send(MSGQCB* msgq, const void* msg, unsigned int len, unsigned int prio)
+{
+	if (len > msgq->msgsize || prio >= MSGQ_PRIORITIES)
+		return -1;
+
+	/*Copy the message before waiting*/
+	MSGNODE* m = (MSGNODE*)malloc(sizeof(MSGNODE) + len);
+	if (m == NULL)
+		return -1;
+	rlnode_init(& m->node, m);
+	m->len = len;
+	if (len > 0)
+		memcpy(m->data, msg, len);
+
+	while (msgq->count >= msgq->maxmsg)
+		stream_wait(& msgq->nonfull, NO_TIMEOUT);
+
+	rlist_push_back(& msgq->queue[prio], & m->node);
+	msgq->nonempty_prios |= (1u << prio);
+	msgq->count++;
+
+	kernel_signal(& msgq->nonempty);
+	poll_notify(& msgq->pollers);
+	return 0;
+}
+
+/*Receive the next message, waiting for one as needed.
+Returns the size of the message on success, otherwise -1*/
+static int msgq_receive(MSGQCB* msgq, void* buf, unsigned int size, unsigned int* prio)
+{
+	while (msgq->count == 0)
+		stream_wait(& msgq->nonempty, NO_TIMEOUT);
+
+	/*The highest non-empty priority*/
+	unsigned int p = 31 - __builtin_clz(msgq->nonempty_prios);
+	MSGNODE* m = msgq->queue[p].next->obj;
+
+	if (m->len > size){
+		/*The message stays, let another receiver have it*/
+		kernel_signal(& msgq->nonempty);
+		return -1;
+	}
+
+	rlist_remove(& m->node);
+	if (is_rlist_empty(& msgq->queue[p]))
+		msgq->nonempty_prios &= ~(1u << p);
+	/*Every receive makes room for one sender, whether or not the queue was full*/
+	kernel_signal(& msgq->nonfull);
+	if (msgq->count-- == msgq->maxmsg)
+		poll_notify(& msgq->pollers);
+
+	int len = m->len;
+	memcpy(buf, m->data, len);
+	free(m);
+
+	if (prio != NULL)
+		*prio = p;
+	return len;
+}
+
+/*Read a message from the queue*/
+static int msgq_read(void* this, char* buf, unsigned int size)
+{
+	return msgq_receive((MSGQCB*)this, buf, size, NULL);
+}
+
+/*Write a message of priority 0 to the queue.
+Returns the size of the message on success, otherwise -1*/
+static int msgq_write(void* this, const char* buf, unsigned int size)
+{
+	/*An empty write only checks that the stream is writable, as for the 
+	  other streams. Empty messages are sent with MsgSend*/
+	if (size == 0)
+		return 0;
+	return (msgq_send((MSGQCB*)this, buf, size, 0) == 0) ? (int)size : -1;
+}
+
+/*Destroy the queue, with any messages left in it*/
+static int msgq_close(void* this)
+{
+	MSGQCB* msgq = (MSGQCB*)this;
+
+	for (int p = 0; p < MSGQ_PRIORITIES; p++)
+		while (! is_rlist_empty(& msgq->queue[p]))
+			free(rlist_pop_front(& msgq->queue[p])->obj);
+	poll_list_clear(& msgq->pollers);
+	free(msgq);
+	return 0;
+}
+
+/*Return the events of the queue*/
+static int msgq_poll(void* this, poll_hook* hook)
+{
+	MSGQCB* msgq = (MSGQCB*)this;
+
+	if (hook != NULL)
+		poll_hook_attach(hook, & msgq->pollers, NULL);
+	return ((msgq->count > 0) ? POLL_READ : 0) | ((msgq->count < msgq->maxmsg) ? POLL_WRITE : 0);
+}
+
+/* The file operations of a message queue */
+static file_ops msgqOps = {
+	.Open = NULL,
+	.Read = msgq_read,
+	.Write = msgq_write,
+	.Close = msgq_close,
+	.Poll = msgq_poll
+};
+
+/*Return the queue of a file id, or NULL if it is not a message queue*/
+static MSGQCB* get_msgq(Fid_t fd)
+{
+	FCB* fcb = get_fcb(fd);
+	if (fcb == NULL || fcb->streamfunc != &msgqOps)
+		return NULL;
+	return (MSGQCB*)fcb->streamobj;
+}
+
+
+Fid_t sys_MsgQueue(unsigned int maxmsg, unsigned int msgsize)
+{
+	if (maxmsg == 0 || msgsize == 0 || msgsize > MSGQ_MAX_MSGSIZE)
+		return NOFILE;
+
+	MSGQCB* msgq = (MSGQCB*)malloc(sizeof(MSGQCB));
+	if (msgq == NULL)
+		return NOFILE;
+
+	Fid_t fid;
+	FCB* fcb;
+	if (FCB_reserve(1, &fid, &fcb) == 0){
+		free(msgq);
+		return NOFILE;
+	}
+
+	for (int p = 0; p < MSGQ_PRIORITIES; p++)
+		rlnode_init(& msgq->queue[p], NULL);
+	msgq->nonempty_prios = 0;
+	msgq->count = 0;
+	msgq->maxmsg = maxmsg;
+	msgq->msgsize = msgsize;
+	msgq->nonempty = COND_INIT;
+	msgq->nonfull = COND_INIT;
+	rlnode_init(& msgq->pollers, NULL);
+
+	fcb->streamobj = msgq;
+	fcb->streamfunc = &msgqOps;
+	fcb->streamtype = STREAM_MSGQ;
+	return fid;
+}
+
+
+int sys_MsgSend(Fid_t fd, const void* msg, unsigned int len, unsigned int prio)
+{
+	MSGQCB* msgq = get_msgq(fd);
+	if (msgq == NULL || (msg == NULL && len > 0))
+		return -1;
+
+	/* make sure that the queue will not be closed (by another thread)
+	   while we are using it! */
+	FCB* fcb = get_fcb(fd);
+	FCB_incref(fcb);
+	int retcode = FCB_would_block(fcb, POLL_WRITE) ? WOULD_BLOCK : msgq_send(msgq, msg, len, prio);
+	if (retcode == 0)
+		CURPROC->usage.bytes_written[STREAM_MSGQ] += len;
+	FCB_decref(fcb);
+
+	return retcode;
+}
+
+
+int sys_MsgReceive(Fid_t fd, void* buf, unsigned int size, unsigned int* prio)
+{
+	MSGQCB* msgq = get_msgq(fd);
+	if (msgq == NULL || (buf == NULL && size > 0))
+		return -1;
+
+	FCB* fcb = get_fcb(fd);
+	FCB_incref(fcb);
+	int retcode = FCB_would_block(fcb, POLL_READ) ? WOULD_BLOCK : msgq_receive(msgq, buf, size, prio);
+	if (retcode > 0)
+		CURPROC->usage.bytes_read[STREAM_MSGQ] += retcode;
+	FCB_decref(fcb);
+
+	return retcode;
+}
@@ -6,68 +6,575 @@
 #include "kernel_proc.h"
 #include "kernel_pipe.h"
 
-/*Put a character to the buffer of the pipe. 
-Returns 1 on success, otherwise 0*/
-int buf_put(PIPECB* pipe, char c)
+/*
+  The pipe buffer is a queue of fixed-size chunks. Chunks are taken from
+  a pool when data is written, and returned to it as soon as their data 
+  has been read, so the memory of a pipe follows the data it holds, up 
+  to its capacity. An idle pipe holds no chunks.
+*/
+
+/*The maximum number of free chunks kept in the pool*/
+#define PIPE_CHUNK_POOL_MAX 256
+
+static rlnode chunk_pool = { .obj=NULL, .prev=&chunk_pool, .next=&chunk_pool };
+static unsigned int chunk_pool_count = 0;
+
+/*Get a chunk from the pool, or allocate it. Chunks are not zeroed*/
+static pipe_chunk* acquire_chunk()
+{
+	if (! is_rlist_empty(&chunk_pool)){
+		chunk_pool_count--;
+		return rlist_pop_front(&chunk_pool)->obj;
+	}
+	pipe_chunk* chunk = (pipe_chunk*)malloc(sizeof(pipe_chunk));
+	if (chunk != NULL)
+		rlnode_init(&chunk->node, chunk);
+	return chunk;
+}
+
+/*Return a chunk to the pool*/
+static void release_chunk(pipe_chunk* chunk)
+{
+	if (chunk_pool_count < PIPE_CHUNK_POOL_MAX){
+		rlist_push_front(&chunk_pool, &chunk->node);
+		chunk_pool_count++;
+	}
+	else
+		free(chunk);
+}
+
+/*
+  The rings of the SPSC mode (see below) are kept in a pool of their own,
+  since a ring is released every time its pipe drains. Only rings of the
+  default capacity are pooled. A free ring holds its pool node.
+*/
+
+/*The maximum number of free rings kept in the pool*/
+#define PIPE_RING_POOL_MAX 8
+
+static rlnode ring_pool = { .obj=NULL, .prev=&ring_pool, .next=&ring_pool };
+static unsigned int ring_pool_count = 0;
+
+/*Get a ring of the given size from the pool, or allocate it*/
+static char* acquire_ring(unsigned int size)
+{
+	if (size == PIPE_DEFAULT_SIZE && ! is_rlist_empty(&ring_pool)){
+		ring_pool_count--;
+		return rlist_pop_front(&ring_pool)->obj;
+	}
+	return (char*)malloc(size);
+}
+
+/*Return a ring of the given size to the pool*/
+static void release_ring(char* ring, unsigned int size)
 {
-    if (pipe->w == pipe->r  &&  pipe->full){
-        return 0;                  //buffer overrun
-    }
-    *pipe->w++ = c;                // insert c into buffer
-    if (pipe->w >= pipe->tail)     // check if we are at the end of circular buffer
-        pipe->w = pipe->buffer;    // return to the begin
+	if (ring != NULL && size == PIPE_DEFAULT_SIZE && ring_pool_count < PIPE_RING_POOL_MAX){
+		rlnode* node = rlnode_init((rlnode*)ring, ring);
+		rlist_push_front(&ring_pool, node);
+		ring_pool_count++;
+	}
+	else
+		free(ring);
+}
 
-    if (pipe->w == pipe->r)        // check if we are try to go out of the buffer
-        pipe->full = 1;            // the buffer is full
-    return 1;              
+/*Release all the chunks of the pipe*/
+static void release_chunks(PIPECB* pipe)
+{
+	while (! is_rlist_empty(&pipe->chunks))
+		release_chunk(rlist_pop_front(&pipe->chunks)->obj);
+	pipe->r = pipe->w = 0;
 }
 
-/*Get a character from the buffer of the pipe. 
-Returns 1 on success, otherwise 0*/
-int buf_get(PIPECB* pipe, char *pc)
+/*The buffer cannot take more data*/
+static inline int buf_full(PIPECB* pipe)
 {
-    if (pipe->w == pipe->r  &&  !pipe->full)
-        return 0;                  // the buffer empty  FAIL
+	return pipe->count >= pipe->capacity;
+}
 
-    *pc = *pipe->r++;              // pick up the next char to be returned
-    if (pipe->r >= pipe->tail)     // check if we are at the end of circular buffer
-        pipe->r = pipe->buffer;    // return to the begin
+/*Copy up to size bytes into the buffer of the pipe, one memcpy per chunk. 
+Returns the number of bytes copied*/
+static unsigned int buf_put(PIPECB* pipe, const char* buf, unsigned int size)
+{
+	unsigned int n = buf_full(pipe) ? 0 : pipe->capacity - pipe->count;    //free space
+	if (n > size) n = size;
+
+	unsigned int done = 0;
+	while (done < n){
+		/*Add a chunk when the last one is full*/
+		if (is_rlist_empty(&pipe->chunks) || pipe->w == PIPE_CHUNK_SIZE){
+			pipe_chunk* chunk = acquire_chunk();
+			if (chunk == NULL) break;    //out of memory, take what we have
+			if (is_rlist_empty(&pipe->chunks)) pipe->r = 0;
+			rlist_push_back(&pipe->chunks, &chunk->node);
+			pipe->w = 0;
+		}
+
+		pipe_chunk* tail = pipe->chunks.prev->obj;
+		unsigned int k = PIPE_CHUNK_SIZE - pipe->w;
+		if (k > n - done) k = n - done;
+		memcpy(tail->data + pipe->w, buf + done, k);
+		pipe->w += k;
+		done += k;
+	}
 
-    pipe->full = 0;               // if you read at least one character, the buffer is not full.
-    return 1;             
+	pipe->count += done;
+	return done;
 }
 
+/*The number of bytes that can be read from the first chunk*/
+static inline unsigned int buf_head_size(PIPECB* pipe)
+{
+	if (pipe->count == 0) return 0;
+	return (pipe->chunks.next == pipe->chunks.prev) ? pipe->w - pipe->r : PIPE_CHUNK_SIZE - pipe->r;
+}
 
-/*Read data from the pipe 
-Returns the size that we read on success, otherwise 0*/
-int pipe_read(void* this, char *buf, unsigned int size){
+/*Drop k bytes from the first chunk, k <= buf_head_size(pipe)*/
+static void buf_consume(PIPECB* pipe, unsigned int k)
+{
+	pipe->r += k;
+	pipe->count -= k;
+	if (pipe->count == 0)
+		release_chunks(pipe);
+	else if (pipe->r == PIPE_CHUNK_SIZE){
+		release_chunk(rlist_pop_front(&pipe->chunks)->obj);
+		pipe->r = 0;
+	}
+}
 
-	PIPECB* mypipe = (PIPECB *)this;
+/*Copy up to size bytes out of the buffer of the pipe, one memcpy per chunk.
+Returns the number of bytes copied*/
+static unsigned int buf_get(PIPECB* pipe, char* buf, unsigned int size)
+{
+	unsigned int done = 0;
+	while (done < size && pipe->count > 0){
+		pipe_chunk* head = pipe->chunks.next->obj;
+		unsigned int k = buf_head_size(pipe);
+		if (k > size - done) k = size - done;
+		memcpy(buf + done, head->data + pipe->r, k);
+		buf_consume(pipe, k);
+		done += k;
+	}
+	return done;
+}
+
+/*Free the pipe, when both ends are closed*/
+static void free_pipe(PIPECB* pipe)
+{
+	poll_list_clear(& pipe->pollers);
+	release_chunks(pipe);
+	release_ring(pipe->ring, pipe->capacity);
+	free(pipe);
+}
+
+
+/*Notify the pollers of the pipe*/
+static inline void pipe_notify(PIPECB* pipe)
+{
+	if (! is_rlist_empty(& pipe->pollers))
+		poll_notify(& pipe->pollers);
+}
+
+
+/*Wait at a pipe or socket condition, charging the blocked time to the current process.
+Returns 1 if signalled, 0 on timeout*/
+int stream_wait(CondVar* cv, TimerDuration timeout)
+{
+	TimerDuration start = bios_clock();
+	int ret = kernel_timedwait(cv, SCHED_PIPE, timeout);
+	CURPROC->usage.block_time += bios_clock() - start;
+	return ret;
+}
+
+/*Like stream_wait, for a condition that interrupt handlers signal after setting *event.
+Returns 1 if signalled or set, 0 on timeout*/
+int stream_wait_event(CondVar* cv, volatile sig_atomic_t* event, TimerDuration timeout)
+{
+	TimerDuration start = bios_clock();
+	int ret = kernel_wait_event(cv, event, SCHED_PIPE, timeout);
+	CURPROC->usage.block_time += bios_clock() - start;
+	return ret;
+}
+
+/*Return 1 if an end of a pipe (a pipe end or a socket) is in non-blocking mode*/
+static inline int pipe_nonblock(FCB* end)
+{
+	return end != NULL && FCB_nonblock(end);
+}
+
+
+/*
+  Single-producer/single-consumer mode.
+
+  A new pipe starts with one reader and one writer. While this holds, data 
+  goes through a ring buffer of the capacity of the pipe, whose head and
+  tail counters are only written by the reader and the writer respectively.
+  A transfer drops the kernel lock and copies with acquire/release atomics 
+  on the counters, so a producer and a consumer on different cores stream 
+  without contending for the kernel lock. The lock is only taken to sleep 
+  on an empty or full ring, and to wake up a sleeping peer.
+
+  A sleeper sets its waiting flag and then checks the ring, under the kernel
+  lock. The peer publishes its counter and then checks the flag. Both are 
+  sequentially consistent, so at least one of them sees the other, and the
+  wakeup cannot be lost.
+
+  The ring is released whenever the pipe drains and no transfer is in
+  progress, so that idle pipes do not hold it. It goes back to a small
+  pool of rings, so a pipe that keeps draining does not allocate.
+
+  When a second reader or writer shows up (through Dup2, inheritance, a
+  file id table shared with a child, or threads sharing a file id), or an
+  operation needs the chunk buffer, the pipe leaves the mode for good: 
+  transfers in progress are stopped and resume on the locked path, and the data of the ring moves to the chunks.
+  Splice by a caller that is alone at its end works on the ring, under the
+  kernel lock, and keeps the mode.
+*/
+
+/*The pipe is in the SPSC mode, and the caller is alone at an end of it*/
+static int spsc_alone(PIPECB* pipe, FCB* end, int busy)
+{
+	if (pipe->spsc != SPSC_ON)
+		return 0;
+
+	/* One file id and the caller hold the FCB, and nobody else is at this end.
+	   A table shared with another process holds a single reference for all
+	   of them, so the fid is only ours if the table is not shared */
+	FIDT* fidt = CURPROC->fidt;
+	return ! busy && end->refcount <= 2 && fidt != NULL && fidt->refcount == 1;
+}
+
+/*Make sure that the pipe has a ring. Returns 0 if we are out of memory*/
+static int spsc_ring(PIPECB* pipe)
+{
+	/* The ring is allocated when a transfer finds none. Counters wrap around modulo its size */
+	if (pipe->ring == NULL){
+		if ((pipe->capacity & (pipe->capacity - 1)) != 0)
+			return 0;
+		pipe->ring = acquire_ring(pipe->capacity);
+	}
+	return pipe->ring != NULL;
+}
+
+/*Start an SPSC transfer at an end of the pipe. Returns 0 if the locked path must be taken*/
+static int spsc_begin(PIPECB* pipe, FCB* end, int* busy)
+{
+	if (! spsc_alone(pipe, end, *busy) || ! spsc_ring(pipe))
+		return 0;
+
+	*busy = 1;
+	kernel_unlock();
+	return 1;
+}
+
+/*End an SPSC transfer, taking back the kernel lock. The ring of an idle,
+drained pipe is released, and allocated again by the next transfer*/
+static void spsc_end(PIPECB* pipe, int* busy)
+{
+	kernel_lock();
+	*busy = 0;
+	if (pipe->spsc != SPSC_ON)
+		kernel_broadcast(& pipe->spsc_done);
+	else if (! pipe->reader_busy && ! pipe->writer_busy 
+			&& pipe->rd.head == pipe->wr.tail){
+		/* Transfers start under the kernel lock, so nobody uses the ring */
+		release_ring(pipe->ring, pipe->capacity);
+		pipe->ring = NULL;
+	}
+}
+
+/*Wake up the peer, if it sleeps*/
+static void spsc_wakeup(int* waiting, CondVar* cv)
+{
+	if (__atomic_load_n(waiting, __ATOMIC_SEQ_CST)){
+		kernel_lock();
+		kernel_broadcast(cv);
+		kernel_unlock();
+	}
+}
+
+/*
+  Transfers work on a vector of buffers, so that ReadV and WriteV move a 
+  whole message at once, with a single wakeup of the peer. Read and Write 
+  pass a vector of one buffer.
+*/
+
+/*A position in a vector of buffers*/
+typedef struct iov_cursor
+{
+	const iovec_t* iov;       //the current buffer
+	const iovec_t* end;       //past the last buffer
+	unsigned int off;         //the position in the current buffer
+} iov_cursor;
+
+static inline void iov_cursor_init(iov_cursor* cur, const iovec_t* iov, unsigned int iovcnt)
+{
+	cur->iov = iov;
+	cur->end = iov + iovcnt;
+	cur->off = 0;
+}
+
+/*The bytes left in the current buffer, after skipping empty buffers. Returns 0 at the end*/
+static inline unsigned int iov_cursor_len(iov_cursor* cur)
+{
+	while (cur->iov != cur->end && cur->off == cur->iov->len){
+		cur->iov++;
+		cur->off = 0;
+	}
+	return (cur->iov == cur->end) ? 0 : cur->iov->len - cur->off;
+}
+
+static inline char* iov_cursor_ptr(iov_cursor* cur)
+{
+	return (char*)cur->iov->base + cur->off;
+}
+
+/*The total size of a vector*/
+static unsigned int iov_total(const iovec_t* iov, unsigned int iovcnt)
+{
+	unsigned int total = 0;
+	for (unsigned int i = 0; i < iovcnt; i++)
+		total += iov[i].len;
+	return total;
+}
+
+/*Copy n bytes from the ring at position head to the vector*/
+static void ring_get(PIPECB* pipe, unsigned int head, iov_cursor* cur, unsigned int n)
+{
+	unsigned int mask = pipe->capacity - 1;
+	while (n > 0){
+		unsigned int off = head & mask;
+		unsigned int k = iov_cursor_len(cur);
+		if (k > n) k = n;
+		if (k > mask + 1 - off) k = mask + 1 - off;
+		memcpy(iov_cursor_ptr(cur), pipe->ring + off, k);
+		cur->off += k;
+		head += k;
+		n -= k;
+	}
+}
+
+/*Copy n bytes from the vector to the ring at position tail*/
+static void ring_put(PIPECB* pipe, unsigned int tail, iov_cursor* cur, unsigned int n)
+{
+	unsigned int mask = pipe->capacity - 1;
+	while (n > 0){
+		unsigned int off = tail & mask;
+		unsigned int k = iov_cursor_len(cur);
+		if (k > n) k = n;
+		if (k > mask + 1 - off) k = mask + 1 - off;
+		memcpy(pipe->ring + off, iov_cursor_ptr(cur), k);
+		cur->off += k;
+		tail += k;
+		n -= k;
+	}
+}
+
+/*Copy up to size bytes from the ring, as soon as need bytes are read, or at 
+end of data. Stops early if the pipe leaves the SPSC mode*/
+static unsigned int spsc_read(PIPECB* pipe, iov_cursor* cur, unsigned int size, unsigned int need)
+{
+	unsigned int head = pipe->rd.head;
+	unsigned int count = 0;
+
+	while (__atomic_load_n(& pipe->spsc, __ATOMIC_RELAXED) == SPSC_ON){
+		unsigned int n = __atomic_load_n(& pipe->wr.tail, __ATOMIC_ACQUIRE) - head;
+		if (n > size - count) n = size - count;
+
+		if (n > 0){
+			ring_get(pipe, head, cur, n);
+			head += n;
+			count += n;
+			__atomic_store_n(& pipe->rd.head, head, __ATOMIC_SEQ_CST);
+			spsc_wakeup(& pipe->wr.waiting, & pipe->isFull);
+		}
+
+		if (count >= need || pipe_nonblock(pipe->reader))
+			break;
+
+		/* The ring is empty, wait for the writer */
+		kernel_lock();
+		__atomic_store_n(& pipe->rd.waiting, 1, __ATOMIC_SEQ_CST);
+		int eof = 0;
+		while (pipe->spsc == SPSC_ON && __atomic_load_n(& pipe->wr.tail, __ATOMIC_SEQ_CST) == head){
+			if (pipe->writer == NULL){
+				eof = 1;
+				break;
+			}
+			stream_wait(& pipe->isEmpty, NO_TIMEOUT);
+		}
+		__atomic_store_n(& pipe->rd.waiting, 0, __ATOMIC_RELAXED);
+		kernel_unlock();
+
+		if (eof)
+			break;
+	}
+
+	return count;
+}
+
+/*Copy size bytes to the ring, waiting for room as needed. Stops early if 
+the reader is gone, or the pipe leaves the SPSC mode*/
+static unsigned int spsc_write(PIPECB* pipe, iov_cursor* cur, unsigned int size)
+{
+	unsigned int tail = pipe->wr.tail;
+	unsigned int count = 0;
+
+	while (count < size && __atomic_load_n(& pipe->spsc, __ATOMIC_RELAXED) == SPSC_ON){
+		unsigned int n = pipe->capacity - (tail - __atomic_load_n(& pipe->rd.head, __ATOMIC_ACQUIRE));
+		if (n > size - count) n = size - count;
+
+		if (n > 0){
+			ring_put(pipe, tail, cur, n);
+			tail += n;
+			count += n;
+			__atomic_store_n(& pipe->wr.tail, tail, __ATOMIC_SEQ_CST);
+			spsc_wakeup(& pipe->rd.waiting, & pipe->isEmpty);
+			continue;
+		}
+
+		if (pipe_nonblock(pipe->writer))
+			break;
+
+		/* The ring is full, wait for the reader */
+		kernel_lock();
+		__atomic_store_n(& pipe->wr.waiting, 1, __ATOMIC_SEQ_CST);
+		int gone = 0;
+		while (pipe->spsc == SPSC_ON 
+			&& tail - __atomic_load_n(& pipe->rd.head, __ATOMIC_SEQ_CST) == pipe->capacity){
+			if (pipe->reader == NULL){
+				gone = 1;
+				break;
+			}
+			stream_wait(& pipe->isFull, NO_TIMEOUT);
+		}
+		__atomic_store_n(& pipe->wr.waiting, 0, __ATOMIC_RELAXED);
+		kernel_unlock();
+
+		if (gone)
+			break;
+	}
+
+	return count;
+}
+
+void pipe_leave_spsc(PIPECB* pipe)
+{
+	if (pipe->spsc == SPSC_ON){
+		pipe->spsc = SPSC_LEAVING;
+
+		/* Stop the transfers in progress, and wait for them */
+		kernel_broadcast(& pipe->isEmpty);
+		kernel_broadcast(& pipe->isFull);
+		while (pipe->reader_busy || pipe->writer_busy)
+			stream_wait(& pipe->spsc_done, NO_TIMEOUT);
+
+		/* Move the data of the ring to the chunks */
+		if (pipe->ring != NULL){
+			unsigned int mask = pipe->capacity - 1;
+			unsigned int n = pipe->wr.tail - pipe->rd.head;
+			unsigned int off = pipe->rd.head & mask;
+			unsigned int k = (n < mask + 1 - off) ? n : mask + 1 - off;
+			buf_put(pipe, pipe->ring + off, k);
+			buf_put(pipe, pipe->ring, n - k);
+			release_ring(pipe->ring, pipe->capacity);
+			pipe->ring = NULL;
+		}
+
+		pipe->spsc = SPSC_OFF;
+		kernel_broadcast(& pipe->spsc_done);
+	}
+
+	while (pipe->spsc == SPSC_LEAVING)
+		stream_wait(& pipe->spsc_done, NO_TIMEOUT);
+}
+
+
+/*The result of a read of count bytes. A non-blocking read of nothing, 
+before the end of data, would block*/
+static int pipe_read_result(PIPECB* pipe, unsigned int count)
+{
+	if (count == 0 && pipe->writer != NULL && pipe_nonblock(pipe->reader))
+		return WOULD_BLOCK;
+	return count;
+}
+
+/*Read data from the pipe into a vector of buffers. Blocks until at least lowat 
+bytes (or the size of the vector, if smaller) are read, or the writer is gone.
+Returns the size that we read on success (0 at end of data), otherwise -1*/
+int pipe_readv_lowat(PIPECB* mypipe, const iovec_t* iov, unsigned int iovcnt, unsigned int lowat){
 
 	/*Check for invalid pointers */
 	if (mypipe ==NULL || mypipe->reader == NULL){ 
 		return -1;
 	}
 
-	int count = 0;
+	iov_cursor cur;
+	iov_cursor_init(&cur, iov, iovcnt);
+	unsigned int size = iov_total(iov, iovcnt);
+	unsigned int need = (lowat < size) ? lowat : size;
+	unsigned int count = 0;
 
-	for (int i = 0; i < size; i++){
+	if (spsc_begin(mypipe, mypipe->reader, & mypipe->reader_busy)){
+		count = spsc_read(mypipe, &cur, size, need);
+		spsc_end(mypipe, & mypipe->reader_busy);
+		if (count >= need || mypipe->spsc == SPSC_ON)
+			return pipe_read_result(mypipe, count);
+	}
+	pipe_leave_spsc(mypipe);
 
-		/*If the writer is gone and the buffer is empty, return*/
-		if (mypipe->writer ==NULL && mypipe->w == mypipe->r  &&  !mypipe->full)
-		{
-			return count; //end of data
-		}
+	while (1){
 
-		/*While the buffer is empty go to sleep and wake up the writer */
-		while(buf_get(mypipe, &buf[i]) == 0){
-			kernel_broadcast(& mypipe->isFull);		
-			kernel_wait(& mypipe->isEmpty,SCHED_PIPE);
+		/*Take whatever is available*/
+		if (mypipe->count > 0){
+			int was_full = buf_full(mypipe);
+			unsigned int n;
+			while ((n = iov_cursor_len(&cur)) > 0 && mypipe->count > 0){
+				n = buf_get(mypipe, iov_cursor_ptr(&cur), n);
+				cur.off += n;
+				count += n;
+			}
+
+			/*Writers only sleep on a full buffer */
+			if (was_full){
+				kernel_broadcast(& mypipe->isFull);
+				pipe_notify(mypipe);
+			}
 		}
-		count++;
+
+		if (count >= need || mypipe->writer == NULL || pipe_nonblock(mypipe->reader))
+			break;
+
+		/*The buffer is empty, wait for the writer */
+		stream_wait(& mypipe->isEmpty, NO_TIMEOUT);
 	}
 
-	return count;
+	return pipe_read_result(mypipe, count);
+}
+
+int pipe_read_lowat(PIPECB* mypipe, char *buf, unsigned int size, unsigned int lowat){
+	iovec_t iov = { .base = buf, .len = size };
+	return pipe_readv_lowat(mypipe, &iov, 1, lowat);
+}
+
+/*Read data from the pipe, as soon as at least its low-water mark is available. 
+Returns the size that we read on success (0 at end of data), otherwise -1*/
+int pipe_read(void* this, char *buf, unsigned int size){
+	PIPECB* mypipe = (PIPECB *)this;
+	return pipe_read_lowat(mypipe, buf, size, (mypipe == NULL) ? 1 : mypipe->lowat);
+}
+
+/*Read data from the pipe into a vector of buffers*/
+static int pipe_readv(void* this, const iovec_t* iov, unsigned int iovcnt){
+	PIPECB* mypipe = (PIPECB *)this;
+	return pipe_readv_lowat(mypipe, iov, iovcnt, (mypipe == NULL) ? 1 : mypipe->lowat);
+}
+
+/*Set the low-water mark of the reader*/
+static int pipe_set_lowat(void* this, unsigned int lowat){
+	PIPECB* mypipe = (PIPECB *)this;
+	mypipe->lowat = lowat;
+	pipe_notify(mypipe);
+	return 0;
 }
 
 /*Close the reader of the pipe 
@@ -83,20 +590,28 @@ int pipe_close_reader(void* this){
 	}
 	mypipe->reader = NULL;
 	kernel_broadcast(& mypipe->isFull); //wake up the writer
+	pipe_notify(mypipe);
 
 	/*If the write is out, erase the pipe*/
 	if (mypipe->writer == NULL){
-		free(mypipe);
+		free_pipe(mypipe);
 	}
 
 	return 0;
 }
 
-/*Write data to the pipe 
-Returns the size that we wrote on success, otherwise 0*/
-int pipe_write(void* this, const char* buf, unsigned int size){
+/*The result of a write of count bytes out of size. A non-blocking write 
+of nothing to a full pipe would block*/
+static int pipe_write_result(PIPECB* pipe, unsigned int count, unsigned int size)
+{
+	if (count == 0 && size > 0)
+		return (pipe->reader != NULL && pipe_nonblock(pipe->writer)) ? WOULD_BLOCK : -1;
+	return count;
+}
 
-	PIPECB* mypipe = (PIPECB *)this;
+/*Write a vector of buffers to the pipe. Blocks until all the data is written, 
+or the reader is gone. Returns the size that we wrote on success, otherwise -1*/
+int pipe_writev(PIPECB* mypipe, const iovec_t* iov, unsigned int iovcnt){
 
 	/*Check for invalid pointers */	
 	if (mypipe ==NULL || mypipe->writer== NULL || mypipe->reader== NULL)
@@ -104,19 +619,64 @@ int pipe_write(void* this, const char* buf, unsigned int size){
 		return -1;
 	}
 
-	int count = 0;
+	iov_cursor cur;
+	iov_cursor_init(&cur, iov, iovcnt);
+	unsigned int size = iov_total(iov, iovcnt);
+	unsigned int count = 0;
 
-	for (int i = 0; i < size; i++)
+	if (spsc_begin(mypipe, mypipe->writer, & mypipe->writer_busy)){
+		count = spsc_write(mypipe, &cur, size);
+		spsc_end(mypipe, & mypipe->writer_busy);
+		if (count == size || mypipe->spsc == SPSC_ON)
+			return pipe_write_result(mypipe, count, size);
+	}
+	pipe_leave_spsc(mypipe);
+
+	while (count < size)
 	{
-		/*While the buffer is full go to sleep and wake up the reader */
-		while(buf_put(mypipe, buf[i]) == 0){
-			kernel_broadcast(& mypipe->isEmpty);		
-			kernel_wait(& mypipe->isFull,SCHED_PIPE);
+		/*Nobody will read the rest*/
+		if (mypipe->reader == NULL)
+			break;
+
+		/*While the buffer is full, wait for the reader */
+		if (buf_full(mypipe)){
+			if (pipe_nonblock(mypipe->writer))
+				break;
+			stream_wait(& mypipe->isFull, NO_TIMEOUT);
+			continue;
+		}
+
+		int was_empty = (mypipe->count == 0);
+		unsigned int n, put = 0;
+		while ((n = iov_cursor_len(&cur)) > 0 && !buf_full(mypipe)){
+			n = buf_put(mypipe, iov_cursor_ptr(&cur), n);
+			if (n == 0)
+				break;    //out of memory
+			cur.off += n;
+			put += n;
 		}
-		count++;
+		if (put == 0)
+			break;
+		count += put;
+
+		/*Readers only sleep on an empty buffer, but pollers may wait for the low-water mark */
+		if (was_empty)
+			kernel_broadcast(& mypipe->isEmpty);
+		pipe_notify(mypipe);
 	}
 
-	return count;
+	return pipe_write_result(mypipe, count, size);
+}
+
+/*Write data to the pipe. Blocks until size bytes are written, or the reader is gone.
+Returns the size that we wrote on success, otherwise -1*/
+int pipe_write(void* this, const char* buf, unsigned int size){
+	iovec_t iov = { .base = (void*)buf, .len = size };
+	return pipe_writev((PIPECB *)this, &iov, 1);
+}
+
+static int pipe_writev_op(void* this, const iovec_t* iov, unsigned int iovcnt){
+	return pipe_writev((PIPECB *)this, iov, iovcnt);
 }
 
 /*Close the writer of the pipe 
@@ -131,10 +691,11 @@ int pipe_close_writer(void* this){
 	mypipe->writer = NULL;
 
 	kernel_broadcast(& mypipe->isEmpty);//wake up the reader
+	pipe_notify(mypipe);
 
 	/*If the reader is out, erase the pipe*/
 	if (mypipe->reader == NULL){
-		free(mypipe);
+		free_pipe(mypipe);
 	}
 
 	return 0;
@@ -150,12 +711,65 @@ int pipe_writer_null(void* this, const char* buf, unsigned int size){
 	return -1;
 }
 
+/*Return the pipe of the reader or the writer*/
+static void* pipe_get_reader(void* this, int write){
+	return write ? NULL : this;
+}
+
+static void* pipe_get_writer(void* this, int write){
+	return write ? this : NULL;
+}
+
+/*The bytes in the pipe, in the ring or the chunks*/
+static unsigned int pipe_count(PIPECB* pipe){
+	return (pipe->ring != NULL) 
+		? __atomic_load_n(& pipe->wr.tail, __ATOMIC_ACQUIRE) - __atomic_load_n(& pipe->rd.head, __ATOMIC_ACQUIRE)
+		: pipe->count;
+}
+
+int pipe_poll(PIPECB* pipe, int write, unsigned int lowat, poll_hook* hook){
+
+	if (pipe == NULL)
+		return write ? (POLL_WRITE | POLL_HANGUP) : (POLL_READ | POLL_HANGUP);
+
+	if (hook != NULL){
+		/*SPSC transfers do not notify, they run without the kernel lock*/
+		pipe_leave_spsc(pipe);
+		poll_hook_attach(hook, & pipe->pollers, NULL);
+	}
+
+	unsigned int count = pipe_count(pipe);
+
+	if (write){
+		if (pipe->reader == NULL)
+			return POLL_WRITE | POLL_HANGUP;   //a Write fails at once
+		return (count < pipe->capacity) ? POLL_WRITE : 0;
+	}
+
+	if (pipe->writer == NULL)
+		return POLL_READ | POLL_HANGUP;        //a Read returns what is left, or end of data
+	return (count > 0 && count >= lowat) ? POLL_READ : 0;
+}
+
+static int pipe_poll_reader(void* this, poll_hook* hook){
+	PIPECB* mypipe = (PIPECB *)this;
+	return pipe_poll(mypipe, 0, mypipe->lowat, hook);
+}
+
+static int pipe_poll_writer(void* this, poll_hook* hook){
+	return pipe_poll((PIPECB *)this, 1, 0, hook);
+}
+
 /* File operations for the reader */
 static file_ops pipeReadOps = {
 	.Open = NULL,
 	.Read = pipe_read,
 	.Write = pipe_writer_null,
-	.Close = pipe_close_reader
+	.Close = pipe_close_reader,
+	.SetLowWater = pipe_set_lowat,
+	.GetPipe = pipe_get_reader,
+	.ReadV = pipe_readv,
+	.Poll = pipe_poll_reader
 };
 
 /* File operations for the writer */
@@ -163,7 +777,10 @@ static file_ops pipeWriteOps = {
 	.Open = NULL,
 	.Read = pipe_reader_null,
 	.Write = pipe_write,
-	.Close = pipe_close_writer
+	.Close = pipe_close_writer,
+	.GetPipe = pipe_get_writer,
+	.WriteV = pipe_writev_op,
+	.Poll = pipe_poll_writer
 };
 
 /* Initialization of the pipe control block */
@@ -177,17 +794,21 @@ PIPECB* init_pipe(){
 		return NULL;
 	}
 
-	mypipe->w = mypipe->r = mypipe->buffer;       // init to any slot in buffer
-    mypipe->tail = & mypipe->buffer[BUF_SIZE];    // the last valid slot in buffer
-    mypipe->full = 0;                             // buffer is empty at the beginning
+	rlnode_init(& mypipe->chunks, NULL);          // no chunks until data arrives
+	mypipe->w = mypipe->r = 0;
+	mypipe->count = 0;                            // buffer is empty at the beginning
+	mypipe->capacity = PIPE_DEFAULT_SIZE;
+	mypipe->lowat = 1;                            // return from Read as soon as there is data
 	mypipe->isEmpty = COND_INIT;
 	mypipe->isFull = COND_INIT;
+	rlnode_init(& mypipe->pollers, NULL);
 
-	/* Put zeros to the buffer */
-	for (int i = 0; i < BUF_SIZE; i++)
-	{
-		mypipe->buffer[i] = 0;
-	}
+	mypipe->spsc = SPSC_OFF;                      // sys_Pipe turns it on
+	mypipe->ring = NULL;
+	mypipe->reader_busy = mypipe->writer_busy = 0;
+	mypipe->spsc_done = COND_INIT;
+	mypipe->rd.head = mypipe->wr.tail = 0;
+	mypipe->rd.waiting = mypipe->wr.waiting = 0;
 
 	return mypipe;
 }
@@ -212,12 +833,276 @@ int sys_Pipe(pipe_t* pipe)
 	pipe->read = fid[0];
 	fcb[0]->streamobj = mypipe;
 	fcb[0]->streamfunc = &pipeReadOps;
+	fcb[0]->streamtype = STREAM_PIPE;
 
 	mypipe->writer = fcb[1];
 	pipe->write = fid[1];
 	fcb[1]->streamobj = mypipe;
 	fcb[1]->streamfunc = &pipeWriteOps;
+	fcb[1]->streamtype = STREAM_PIPE;
+
+	mypipe->spsc = SPSC_ON;
 
 	return 0;
 }
 
+
+/*Splice works on the ring of a pipe in the SPSC mode, if the caller is alone
+at its end. Otherwise the pipe leaves the mode. Returns 1 for the ring*/
+static int splice_ring(PIPECB* pipe, FCB* end, int busy, int write)
+{
+	if (spsc_alone(pipe, end, busy) && (! write || spsc_ring(pipe)))
+		return 1;
+	pipe_leave_spsc(pipe);
+	return 0;
+}
+
+/*The bytes that Splice can take from the input pipe*/
+static unsigned int splice_avail(PIPECB* in, int ring)
+{
+	return ring ? __atomic_load_n(& in->wr.tail, __ATOMIC_SEQ_CST) - in->rd.head : in->count;
+}
+
+/*The room for Splice in the output pipe*/
+static unsigned int splice_room(PIPECB* out, int ring)
+{
+	if (ring)
+		return out->capacity - (out->wr.tail - __atomic_load_n(& out->rd.head, __ATOMIC_SEQ_CST));
+	return buf_full(out) ? 0 : out->capacity - out->count;
+}
+
+/*Move up to len bytes from the buffer of pipe in, to the buffer of pipe out.
+Waits until there is some data in the input and some space in the output.
+Returns the bytes moved, 0 at the end of data of the input, otherwise -1*/
+int pipe_splice(PIPECB* in, PIPECB* out, unsigned int len){
+
+	if (in == NULL || in->reader == NULL || out == NULL || out->writer == NULL || in == out)
+		return -1;
+
+	int in_ring, out_ring;
+	while (1){
+		/*A pipe may leave the SPSC mode while we sleep*/
+		in_ring = splice_ring(in, in->reader, in->reader_busy, 0);
+		out_ring = splice_ring(out, out->writer, out->writer_busy, 1);
+		if (in_ring && in->spsc != SPSC_ON)
+			continue;
+
+		/*Nobody will read the output*/
+		if (out->reader == NULL)
+			return -1;
+
+		/*In the SPSC mode, the peer only wakes up a sleeper that has set 
+		  its waiting flag, so the condition is checked again after setting it*/
+		if (splice_avail(in, in_ring) == 0){
+			if (in->writer == NULL)
+				return 0;  //end of data
+			if (pipe_nonblock(in->reader))
+				return WOULD_BLOCK;
+			__atomic_store_n(& in->rd.waiting, in_ring, __ATOMIC_SEQ_CST);
+			if (splice_avail(in, in_ring) == 0)
+				stream_wait(& in->isEmpty, NO_TIMEOUT);
+			__atomic_store_n(& in->rd.waiting, 0, __ATOMIC_RELAXED);
+			continue;
+		}
+
+		if (splice_room(out, out_ring) == 0){
+			if (pipe_nonblock(out->writer))
+				return WOULD_BLOCK;
+			__atomic_store_n(& out->wr.waiting, out_ring, __ATOMIC_SEQ_CST);
+			if (splice_room(out, out_ring) == 0)
+				stream_wait(& out->isFull, NO_TIMEOUT);
+			__atomic_store_n(& out->wr.waiting, 0, __ATOMIC_RELAXED);
+			continue;
+		}
+		break;
+	}
+
+	unsigned int n = splice_room(out, out_ring);
+	unsigned int avail = splice_avail(in, in_ring);
+	if (n > avail) n = avail;
+	if (n > len) n = len;
+
+	int in_was_full = buf_full(in);
+	int out_was_empty = (out->count == 0);
+
+	/*Copy the input piece by piece to the output*/
+	unsigned int head = in->rd.head, tail = out->wr.tail;
+	unsigned int done = 0;
+	while (done < n){
+		char* src;
+		unsigned int k;
+		if (in_ring){
+			unsigned int off = head & (in->capacity - 1);
+			src = in->ring + off;
+			k = in->capacity - off;
+		}
+		else {
+			pipe_chunk* chunk = in->chunks.next->obj;
+			src = chunk->data + in->r;
+			k = buf_head_size(in);
+		}
+		if (k > n - done) k = n - done;
+
+		if (out_ring){
+			iovec_t iov = { .base = src, .len = k };
+			iov_cursor cur;
+			iov_cursor_init(&cur, &iov, 1);
+			ring_put(out, tail, &cur, k);
+			tail += k;
+		}
+		else {
+			k = buf_put(out, src, k);
+			if (k == 0) break;    //out of memory
+		}
+
+		if (in_ring)
+			head += k;
+		else
+			buf_consume(in, k);
+		done += k;
+	}
+
+	/*Nothing was moved, because we are out of memory*/
+	if (done == 0)
+		return -1;
+
+	/*Publish the counters of the rings, and wake up the peers*/
+	if (in_ring)
+		__atomic_store_n(& in->rd.head, head, __ATOMIC_SEQ_CST);
+	if (out_ring)
+		__atomic_store_n(& out->wr.tail, tail, __ATOMIC_SEQ_CST);
+
+	if (in_ring || in_was_full){
+		kernel_broadcast(& in->isFull);
+		pipe_notify(in);
+	}
+	if (out_ring || out_was_empty)
+		kernel_broadcast(& out->isEmpty);
+	pipe_notify(out);
+
+	return done;
+}
+
+
+/*The size of the kernel buffer of Splice, for streams that are not pipes*/
+#define SPLICE_BUF_SIZE 4096
+
+/*A stream that keeps message boundaries, which the kernel buffer of Splice would break*/
+static int splice_keeps_boundaries(FCB* fcb)
+{
+	switch (fcb->streamtype){
+		case STREAM_MSGQ:
+		case STREAM_EVSET:
+		case STREAM_EVENTFD:
+		case STREAM_TIMER:
+			return 1;
+		default:
+			return 0;
+	}
+}
+
+/*The output of the kernel buffer is known to fail, so we must not read.
+The hangup of a socket may be its input, so its pipe is checked instead*/
+static int splice_hangup(FCB* out, PIPECB* pout)
+{
+	if (pout != NULL)
+		return pout->reader == NULL;
+	return out->streamfunc->Poll != NULL
+		&& (out->streamfunc->Poll(out->streamobj, NULL) & POLL_HANGUP);
+}
+
+int sys_Splice(Fid_t fd_in, Fid_t fd_out, unsigned int len)
+{
+	FCB* in = get_fcb(fd_in);
+	FCB* out = get_fcb(fd_out);
+
+	if (in == NULL || out == NULL)
+		return -1;
+	if (len == 0)
+		return 0;
+
+	/* make sure that the streams will not be closed (by another thread) 
+	   while we are using them! */
+	FCB_incref(in);
+	FCB_incref(out);
+
+	int retcode = -1;
+	PIPECB* pin = (in->streamfunc->GetPipe) ? in->streamfunc->GetPipe(in->streamobj, 0) : NULL;
+	PIPECB* pout = (out->streamfunc->GetPipe) ? out->streamfunc->GetPipe(out->streamobj, 1) : NULL;
+
+	if (pin != NULL && pout != NULL){
+		/*Ring to ring*/
+		retcode = pipe_splice(pin, pout, len);
+	}
+	else if ((in->streamfunc->GetPipe != NULL && pin == NULL)
+		|| (out->streamfunc->GetPipe != NULL && pout == NULL)
+		|| splice_keeps_boundaries(in) || splice_keeps_boundaries(out)
+		|| in->streamfunc->Read == NULL || out->streamfunc->Write == NULL
+		|| splice_hangup(out, pout)){
+		/*A pipe end or socket in the wrong direction, a message stream,
+		  or an output that fails at once*/
+		retcode = -1;
+	}
+	else if (FCB_would_block(in, POLL_READ) || FCB_would_block(out, POLL_WRITE)){
+		retcode = WOULD_BLOCK;
+	}
+	else {
+		/*Through a kernel buffer*/
+		char buffer[SPLICE_BUF_SIZE];
+		unsigned int n = (len < SPLICE_BUF_SIZE) ? len : SPLICE_BUF_SIZE;
+
+		/*A non-blocking output pipe must take all that we read*/
+		if (pout != NULL && pipe_nonblock(out) && n > pout->capacity - pipe_count(pout))
+			n = pout->capacity - pipe_count(pout);
+		retcode = in->streamfunc->Read(in->streamobj, buffer, n);
+
+		/*If the output fails, the bytes written so far are returned and 
+		  the rest of the buffer is dropped, since it was consumed from the input*/
+		for (int done = 0; done < retcode; ){
+			int rc = out->streamfunc->Write(out->streamobj, buffer + done, retcode - done);
+			if (rc <= 0){
+				retcode = (done > 0) ? done : -1;
+				break;
+			}
+			done += rc;
+		}
+	}
+
+	if (retcode > 0){
+		CURPROC->usage.bytes_read[in->streamtype] += retcode;
+		CURPROC->usage.bytes_written[out->streamtype] += retcode;
+	}
+
+	FCB_decref(in);
+	FCB_decref(out);
+	return retcode;
+}
+
+
+int sys_SetPipeSize(Fid_t fd, unsigned int size)
+{
+	FCB* fcb = get_fcb(fd);
+
+	if (fcb == NULL || fcb->streamfunc->GetPipe == NULL || size == 0 || size > PIPE_MAX_SIZE)
+		return -1;
+
+	PIPECB* mypipe = fcb->streamfunc->GetPipe(fcb->streamobj, 0);
+	if (mypipe == NULL)
+		mypipe = fcb->streamfunc->GetPipe(fcb->streamobj, 1);
+	if (mypipe == NULL)
+		return -1;
+
+	/*The ring of the SPSC mode has a fixed size*/
+	pipe_leave_spsc(mypipe);
+
+	int was_full = buf_full(mypipe);
+	mypipe->capacity = ((size + PIPE_CHUNK_SIZE - 1) / PIPE_CHUNK_SIZE) * PIPE_CHUNK_SIZE;
+
+	/*Writers only sleep on a full buffer */
+	if (was_full && !buf_full(mypipe)){
+		kernel_broadcast(& mypipe->isFull);
+		pipe_notify(mypipe);
+	}
+
+	return mypipe->capacity;
+}
@@ -2,26 +2,86 @@
 #include "kernel_cc.h"
 #include "kernel_streams.h"
 
-#define BUF_SIZE 8192 //The size of the pipe buffer
+#define PIPE_CHUNK_SIZE 4096              //The size of a chunk of a pipe buffer
+#define PIPE_DEFAULT_SIZE (16*PIPE_CHUNK_SIZE) //The default capacity of a pipe
+#define PIPE_MAX_SIZE (256*PIPE_CHUNK_SIZE)    //The maximum capacity of a pipe
+
+/** A chunk of a pipe buffer */
+typedef struct pipe_chunk
+{
+	rlnode node;                 //the node in the chunk list of the pipe, or the pool
+	char data[PIPE_CHUNK_SIZE];
+}pipe_chunk;
 
 /** Pipe Control Block */
 typedef struct pipe_control_block
 {
-	char buffer[BUF_SIZE];    //a buffer to move data
-	char *w, *r, *tail;       //pointers for easy access
-	int full;                 //If the buffer is full, its value is 1
+	rlnode chunks;            //the chunks of the buffer, in order
+	unsigned int r;           //read position in the first chunk
+	unsigned int w;           //write position in the last chunk
+	unsigned int count;       //the number of bytes in the buffer
+	unsigned int capacity;    //the maximum number of bytes in the buffer
+	unsigned int lowat;       //the low-water mark of the reader
 	FCB* reader;		      //The FCB of the reader thread-process
 	FCB* writer; 	          //The FCB of the writer thread-process
 	CondVar isEmpty, isFull;  //Condition variables for synchronisation of reader and writer
-	
+	rlnode pollers;           //the poll list of both ends
+
+	/* The single-producer/single-consumer mode (see kernel_pipe.c) */
+	int spsc;                 //SPSC_ON, SPSC_LEAVING or SPSC_OFF
+	char* ring;               //the ring buffer of the SPSC mode, or NULL
+	int reader_busy;          //a reader is in an SPSC transfer
+	int writer_busy;          //a writer is in an SPSC transfer
+	CondVar spsc_done;        //signalled when an SPSC transfer ends, or the mode is left
+
+	/* Owned by the reader and the writer respectively, on separate cache lines */
+	struct {
+		unsigned int head;    //the bytes read from the ring so far
+		int waiting;          //the reader sleeps on isEmpty
+	} rd __attribute__((aligned(64)));
+	struct {
+		unsigned int tail;    //the bytes written to the ring so far
+		int waiting;          //the writer sleeps on isFull
+	} wr __attribute__((aligned(64)));
 }PIPECB;
 
+/** The modes of a pipe */
+enum { SPSC_OFF, SPSC_ON, SPSC_LEAVING };
+
 PIPECB* init_pipe();
 
+/*Wait at a pipe or socket condition, charging the blocked time to the current process.
+Returns 1 if signalled, 0 on timeout*/
+int stream_wait(CondVar* cv, TimerDuration timeout);
+
+/*Like stream_wait, for a condition that interrupt handlers signal after setting *event.
+Does not sleep if *event is set. Returns 1 if signalled or set, 0 on timeout*/
+int stream_wait_event(CondVar* cv, volatile sig_atomic_t* event, TimerDuration timeout);
+
 int pipe_read(void* this, char *buf, unsigned int size);
 
+/*Read data from the pipe, returning when at least lowat bytes (or size, if smaller) 
+have been read, or at end of data. Used by pipe_read and by sockets*/
+int pipe_read_lowat(PIPECB* pipe, char *buf, unsigned int size, unsigned int lowat);
+
+/*Read data from the pipe into a vector of buffers, like pipe_read_lowat*/
+int pipe_readv_lowat(PIPECB* pipe, const iovec_t* iov, unsigned int iovcnt, unsigned int lowat);
+
 int pipe_write(void* this, const char* buf, unsigned int size);
 
+/*Write a vector of buffers to the pipe, like pipe_write*/
+int pipe_writev(PIPECB* pipe, const iovec_t* iov, unsigned int iovcnt);
+
+/*Return the events of the read (write=0) or write side of the pipe, for Poll. 
+A NULL pipe is a closed end. If hook is not NULL, attach it to the poll list*/
+int pipe_poll(PIPECB* pipe, int write, unsigned int lowat, poll_hook* hook);
+
+/*Switch the pipe to the locked mode, waiting for any SPSC transfers to finish*/
+void pipe_leave_spsc(PIPECB* pipe);
+
+/*Move up to len bytes from the buffer of pipe in to the buffer of pipe out. Used by Splice*/
+int pipe_splice(PIPECB* in, PIPECB* out, unsigned int len);
+
 int pipe_close_reader(void* this);
 
 int pipe_close_writer(void* this);
\ No newline at end of file
@@ -3,6 +3,7 @@
 #include "kernel_cc.h"
 #include "kernel_proc.h"
 #include "kernel_streams.h"
+#include "kernel_threads.h"
 
 /* 
  The process table and related system calls:
@@ -14,18 +15,38 @@
 
  */
 
-/* The process table */
-PCB PT[MAX_PROC];
+/* 
+  The process table. 
+
+  The table is sparse: it is split into chunks of PT_CHUNK_SIZE PCBs,
+  which are allocated on demand, when the free list of PCBs runs out.
+  Chunks are allocated in pid order and never released while the
+  kernel is running.
+ */
+#define PT_CHUNK_SIZE 256
+#define PT_CHUNKS (MAX_PROC/PT_CHUNK_SIZE)
+
+static PCB* PT[PT_CHUNKS];
+static unsigned int pt_chunks;     /* The number of allocated chunks */
 unsigned int process_count;
 
+/* The list of used (alive or zombie) PCBs, walked by OpenInfo */
+static rlnode PCB_list;
+
 PCB* get_pcb(Pid_t pid)
 {
-  return PT[pid].pstate==FREE ? NULL : &PT[pid];
+  if(pid<0 || pid>=MAX_PROC) return NULL;
+
+  PCB* chunk = PT[pid/PT_CHUNK_SIZE];
+  if(chunk==NULL) return NULL;
+
+  PCB* pcb = &chunk[pid%PT_CHUNK_SIZE];
+  return pcb->pstate==FREE ? NULL : pcb;
 }
   
 Pid_t get_pid(PCB* pcb)
 {
-  return pcb==NULL ? NOPROC : pcb-PT;
+  return pcb==NULL ? NOPROC : pcb->pid;
 }
 
 /* Initialize a PCB */
@@ -36,36 +57,62 @@ static inline void initialize_PCB(PCB* pcb)
   pcb->args = NULL;
   pcb->active_threads =0;
 
-  for(int i=0;i<MAX_FILEID;i++)
-    pcb->FIDT[i] = NULL;
+  pcb->fidt = NULL;
 
   rlnode_init(& pcb->children_list, NULL);
   rlnode_init(& pcb->exited_list, NULL);
   rlnode_init(& pcb->children_node, pcb);
   rlnode_init(& pcb->exited_node, pcb);
+  rlnode_init(& pcb->pt_node, pcb);
+  initialize_PTCB_table(pcb);
   pcb->child_exit = COND_INIT;
 }
 
 
 static PCB* pcb_freelist;
 
-void initialize_processes()
+/*
+  Allocate the next chunk of the process table and add its PCBs
+  to the free list. Returns 0 if the table cannot grow any more.
+
+  Must be called with kernel_mutex held
+*/
+static int grow_process_table()
 {
+  if(pt_chunks == PT_CHUNKS) return 0;
+
+  PCB* chunk = (PCB*)malloc(PT_CHUNK_SIZE*sizeof(PCB));
+  if(chunk == NULL) return 0;
+
   /* initialize the PCBs */
-  for(Pid_t p=0; p<MAX_PROC; p++) {
-    initialize_PCB(&PT[p]);
+  for(int i=0; i<PT_CHUNK_SIZE; i++) {
+    initialize_PCB(&chunk[i]);
+    chunk[i].pid = pt_chunks*PT_CHUNK_SIZE + i;
   }
 
-  /* use the parent field to build a free list */
-  PCB* pcbiter;
-  pcb_freelist = NULL;
-  for(pcbiter = PT+MAX_PROC; pcbiter!=PT; ) {
+  /* use the parent field to build a free list, lowest pid first */
+  for(PCB* pcbiter = chunk+PT_CHUNK_SIZE; pcbiter!=chunk; ) {
     --pcbiter;
     pcbiter->parent = pcb_freelist;
     pcb_freelist = pcbiter;
   }
 
+  PT[pt_chunks++] = chunk;
+  return 1;
+}
+
+void initialize_processes()
+{
+  /* release the chunks of a previous boot, the rest are allocated on demand */
+  for(unsigned int c=0; c<pt_chunks; c++) {
+    free(PT[c]);
+    PT[c] = NULL;
+  }
+  pt_chunks = 0;
+  pcb_freelist = NULL;
+
   process_count = 0;
+  rlnode_init(& PCB_list, NULL);
 
   /* Execute a null "idle" process */
   if(Exec(NULL,0,NULL)!=0)
@@ -80,11 +127,17 @@ PCB* acquire_PCB()
 {
   PCB* pcb = NULL;
 
+  if(pcb_freelist == NULL)
+    grow_process_table();
+
   if(pcb_freelist != NULL) {
     pcb = pcb_freelist;
     pcb->pstate = ALIVE;
     pcb_freelist = pcb_freelist->parent;
     process_count++;
+    rlist_push_back(& PCB_list, & pcb->pt_node);
+    memset(& pcb->usage, 0, sizeof(rusage));
+    memset(& pcb->children_usage, 0, sizeof(rusage));
   }
 
   return pcb;
@@ -96,6 +149,7 @@ PCB* acquire_PCB()
 void release_PCB(PCB* pcb)
 {
   pcb->pstate = FREE;
+  rlist_remove(& pcb->pt_node);
   pcb->parent = pcb_freelist;
   pcb_freelist = pcb;
   process_count--;
@@ -127,9 +181,13 @@ void start_main_thread()
 
 
 /*
-	System call to create a new process.
+  Create a new process, without starting its main thread.
+
+  The main thread (if any) is returned in the INIT state, and the
+  caller must wake it up. Returns NULL if we have run out of PIDs,
+  or of memory for the main thread.
  */
-Pid_t sys_Exec(Task call, int argl, void* args)
+static PCB* create_process(Task call, int argl, void* args)
 {
   PCB *curproc, *newproc;
   
@@ -152,12 +210,8 @@ Pid_t sys_Exec(Task call, int argl, void* args)
     newproc->parent = curproc;
     rlist_push_front(& curproc->children_list, & newproc->children_node);
 
-    /* Inherit file streams from parent */
-    for(int i=0; i<MAX_FILEID; i++) {
-       newproc->FIDT[i] = curproc->FIDT[i];
-       if(newproc->FIDT[i])
-          FCB_incref(newproc->FIDT[i]);
-    }
+    /* Inherit file streams from parent, the table is copied on the first change */
+    newproc->fidt = FIDT_share(curproc->fidt);
   }
 
 
@@ -174,55 +228,91 @@ Pid_t sys_Exec(Task call, int argl, void* args)
     newproc->args=NULL;
 
   /* 
-    Create and wake up the thread for the main function. This must be the last thing
+    Create the thread for the main function. Waking it up must be the last thing
     we do, because once we wakeup the new thread it may run! so we need to have finished
     the initialization of the PCB.
    */
+  newproc->main_thread = NULL;
   if(call != NULL) {
-    newproc->main_thread = spawn_thread(newproc, start_main_thread);
-  
    /****Create the first thread of the process ****/
 
-   /* Create the PTCB*/ 
-   PTCB* myptcb = (struct pt_control_block*)malloc(sizeof(struct pt_control_block));
+   /* Create the PTCB first, so that a failure leaves no thread to undo */ 
+   PTCB* myptcb = acquire_PTCB(newproc, call, argl, args);
   
    if (myptcb == NULL)
    {
      printf("We are out of memory! \n");
-     return NOTHREAD;
+     rlist_remove(& newproc->children_node);
+     FIDT_release(newproc->fidt);
+     newproc->fidt = NULL;
+     free(newproc->args);
+     newproc->args = NULL;
+     cleanup_PTCB_table(newproc);
+     release_PCB(newproc);
+     return NULL;
    }
 
-    /* Initializing the PTCB*/
-   myptcb->cv = COND_INIT;
-   myptcb->task = call;
-   myptcb->argl = argl;
-   myptcb->args = args;
-   myptcb->pcb = newproc;
-   myptcb->joinable = 1;
-   myptcb->exited = 0;
-   myptcb->tid = 1;
-   myptcb->ref_counter = 0;
+   newproc->main_thread = spawn_thread(newproc, start_main_thread);
 
    /*Link TCB with PTCB*/
    myptcb->tcb = newproc->main_thread;
    newproc->main_thread->owner_ptcb = myptcb;
 
-   /*Initialize the list of PTCBs of the process */
-   rlnode_init(&(myptcb->node), myptcb);
-   rlnode_init(&(newproc->ptcb_list), &(myptcb->node));
-
    /*It counts the active threads of the pcb*/
    newproc->active_threads++;
-
-   wakeup(newproc->main_thread);
+   newproc->usage.peak_threads = 1;
   }
 
 
 finish:
+  return newproc;
+}
+
+
+/*
+	System call to create a new process.
+ */
+Pid_t sys_Exec(Task call, int argl, void* args)
+{
+  PCB* newproc = create_process(call, argl, args);
+
+  if(newproc != NULL && newproc->main_thread != NULL)
+    wakeup(newproc->main_thread);
+
   return get_pid(newproc);
 }
 
 
+/*
+  System call to create many processes running the same task.
+  The main threads are woken up in one batch, after all the 
+  processes have been created.
+ */
+int sys_ExecMany(Task call, unsigned int n, int argl, void* args, Pid_t* pids)
+{
+  if(call == NULL) return -1;
+
+  rlnode main_threads;
+  rlnode_init(& main_threads, NULL);
+
+  unsigned int count;
+  for(count=0; count<n; count++) {
+    void* slice = (args!=NULL) ? ((char*)args) + (size_t)count*argl : NULL;
+
+    PCB* newproc = create_process(call, argl, slice);
+    if(newproc == NULL) break;   /* We have run out of PIDs! */
+
+    rlist_push_back(& main_threads, & newproc->main_thread->sched_node);
+    if(pids != NULL)
+      pids[count] = get_pid(newproc);
+  }
+
+  wakeup_many(& main_threads);
+
+  return count;
+}
+
+
 /* System call */
 Pid_t sys_GetPid()
 {
@@ -236,14 +326,40 @@ Pid_t sys_GetPPid()
 }
 
 
+/* Add the resource usage in src to dst */
+static void rusage_add(rusage* dst, const rusage* src)
+{
+  dst->cpu_time += src->cpu_time;
+  dst->context_switches += src->context_switches;
+  dst->syscalls += src->syscalls;
+  for(int i=0; i<STREAM_TYPES; i++) {
+    dst->bytes_read[i] += src->bytes_read[i];
+    dst->bytes_written[i] += src->bytes_written[i];
+  }
+  dst->block_time += src->block_time;
+  if(src->peak_threads > dst->peak_threads)
+    dst->peak_threads = src->peak_threads;
+}
+
+
 static void cleanup_zombie(PCB* pcb, int* status)
 {
   if(status != NULL)
     *status = pcb->exitval;
 
+  /* Fold the usage of the child and its descendants into the parent */
+  PCB* parent = pcb->parent;
+  if(parent != NULL) {
+    rusage_add(& parent->children_usage, & pcb->usage);
+    rusage_add(& parent->children_usage, & pcb->children_usage);
+  }
+
   rlist_remove(& pcb->children_node);
   rlist_remove(& pcb->exited_node);
 
+  /* Recycle the PTCBs of the exited threads */
+  cleanup_PTCB_table(pcb);
+
   release_PCB(pcb);
 }
 
@@ -315,6 +431,65 @@ Pid_t sys_WaitChild(Pid_t cpid, int* status)
 
 }
 
+/*
+  Reap up to n exited children in one call, waiting up to timeout 
+  msec for the first one. The exited list is drained in bulk.
+ */
+int sys_WaitChildren(Pid_t* pids, int* statuses, unsigned int n, timeout_t timeout)
+{
+  PCB* parent = CURPROC;
+
+  if(pids == NULL || n == 0)
+    return -1;
+
+  /* Make sure I have children! */
+  if(is_rlist_empty(& parent->children_list))
+    return -1;
+
+  /* Wait for some child to exit, or for the deadline to pass */
+  TimerDuration deadline = timeout_deadline(timeout);
+  while(is_rlist_empty(& parent->exited_list)) {
+    if(deadline == NO_TIMEOUT) {
+      kernel_wait(& parent->child_exit, SCHED_USER);
+    }
+    else {
+      TimerDuration now = bios_clock();
+      if(now >= deadline) break;
+      kernel_timedwait(& parent->child_exit, SCHED_USER, deadline-now);
+    }
+  }
+
+  /* Reap as many children as we can */
+  unsigned int count = 0;
+  while(count < n && !is_rlist_empty(& parent->exited_list)) {
+    PCB* child = parent->exited_list.next->pcb;
+    assert(child->pstate == ZOMBIE);
+    pids[count] = get_pid(child);
+    cleanup_zombie(child, (statuses != NULL) ? &statuses[count] : NULL);
+    count++;
+  }
+
+  return count;
+}
+
+int sys_GetRusage(rusage_who who, rusage* usage)
+{
+  if(usage == NULL)
+    return -1;
+
+  switch(who) {
+    case RUSAGE_SELF:
+      *usage = CURPROC->usage;
+      return 0;
+    case RUSAGE_CHILDREN:
+      *usage = CURPROC->children_usage;
+      return 0;
+    default:
+      return -1;
+  }
+}
+
+
 void sys_Exit(int exitval)
 {
   /* Right here, we must check that we are not the boot task. If we are, 
@@ -325,6 +500,10 @@ void sys_Exit(int exitval)
 
   PCB *curproc = CURPROC;  /* cache for efficiency */
 
+  /* The calling thread is gone, even if it did not pass through ThreadExit */
+  CURTHREAD->owner_ptcb->exited = 1;
+  CURTHREAD->owner_ptcb->tcb = NULL;
+
   /* Do all the other cleanup we want here, close files etc. */
   if(curproc->args) {
     free(curproc->args);
@@ -332,12 +511,8 @@ void sys_Exit(int exitval)
   }
 
   /* Clean up FIDT */
-  for(int i=0;i<MAX_FILEID;i++) {
-    if(curproc->FIDT[i] != NULL) {
-      FCB_decref(curproc->FIDT[i]);
-      curproc->FIDT[i] = NULL;
-    }
-  }
+  FIDT_release(curproc->fidt);
+  curproc->fidt = NULL;
 
   /* Reparent any children of the exiting process to the 
      initial task */
@@ -376,21 +551,53 @@ void sys_Exit(int exitval)
 
 /** OpenInfo Funtions **/
 
-/*The reader gives the next available info control block. */
+/* Fill a procinfo record from a used PCB */
+static void fill_procinfo(procinfo* info, PCB* pcb)
+{
+  info->pid = get_pid(pcb);
+  info->ppid = get_pid(pcb->parent);
+  info->alive = (pcb->pstate == ALIVE);
+  info->thread_count = pcb->active_threads;
+  info->main_task = pcb->main_task;
+  info->argl = pcb->argl;
+
+  /*Get the right size so as dont go out o the array borders.
+    Zombies have already released their arguments. */
+  if(pcb->args != NULL) {
+    int real_arg = (pcb->argl <= PROCINFO_MAX_ARGS_SIZE) ? pcb->argl : PROCINFO_MAX_ARGS_SIZE; 
+    memcpy(info->args, pcb->args, real_arg);
+  }
+}
+
+/*The reader gives as many of the next used PCBs as fit in the buffer. 
+Returns the number of bytes read, 0 at the end of the stream*/
 int info_read(void* this, char *buf, unsigned int size){
   SICB* infocb = (SICB*)this;
 
-  /*Check if there are available data to give*/
-  if (infocb->elements <=0 || infocb->pointer == infocb->elements)
+  /*The buffer must hold at least one record*/
+  if (size < sizeof(procinfo))
   {
     return -1;
   }
 
-  /*Copy the memory to the given pointer*/
-  memcpy(buf, &infocb->info_list[infocb->pointer], sizeof(infocb->info_list[infocb->pointer]));
-  infocb->pointer++;
+  unsigned int count = 0;
+  while(size - count >= sizeof(procinfo)) {
+    /*Find the next PCB, skipping the cursors of other readers*/
+    rlnode* node = infocb->cursor.next;
+    while(node != &PCB_list && node->pcb == NULL)
+      node = node->next;
+    if(node == &PCB_list)
+      break;    /*end of data*/
+
+    fill_procinfo((procinfo*)(buf+count), node->pcb);
+    count += sizeof(procinfo);
+
+    /*Move the cursor right after the reported PCB*/
+    rlist_remove(& infocb->cursor);
+    rlist_push_front(node, & infocb->cursor);
+  }
 
-  return 1;
+  return count;
 }
 
 /* The writing is not possible for infocb */
@@ -401,6 +608,7 @@ int info_write(void* this, const char* buf, unsigned int size){
 /* Close the infocb */
 int info_close(void* this){
   SICB* infocb = (SICB*)this;
+  rlist_remove(& infocb->cursor);
   free(infocb);
   return 0;
 }
@@ -413,16 +621,10 @@ static file_ops infoOps = {
   .Close = info_close
 };
 
-/* Initialize the info control block and pass the required data */
+/* Initialize the info control block and place its cursor
+   at the head of the list of used PCBs */
 Fid_t sys_OpenInfo()
 {
-  /* Allocate memory for info CB*/
-  SICB* infocb = (SICB*)malloc(sizeof(SICB));
-  if (infocb == NULL)
-  {
-    return NOFILE;
-  }
-
   Fid_t fid;
   FCB* fcb;
 
@@ -432,36 +634,22 @@ Fid_t sys_OpenInfo()
     return NOFILE;
   }
 
+  /* Allocate memory for info CB*/
+  SICB* infocb = (SICB*)malloc(sizeof(SICB));
+  if (infocb == NULL)
+  {
+    FCB_unreserve(1, &fid, &fcb);
+    return NOFILE;
+  }
+
   /*Initialize the FCB */
   fcb->streamobj = infocb;
   fcb->streamfunc = &infoOps;
+  fcb->streamtype = STREAM_INFO;
 
-  infocb->elements = 0;
-  infocb->pointer = 0;
-  int real_arg =0;
-  int j = 0;
-  
-  /*Get the data from the Process Table*/
-  for(Pid_t p=0; p<MAX_PROC; p++) {
-    /*Check if there are useful data to this PCB */
-    if (PT[p].pstate != FREE) 
-    {
-      infocb->info_list[j].pid = get_pid(&PT[p]);
-      infocb->info_list[j].ppid = get_pid(PT[p].parent);
-      infocb->info_list[j].alive = (PT[p].pstate == ALIVE);
-      infocb->info_list[j].thread_count = PT[p].active_threads;
-      infocb->info_list[j].main_task = PT[p].main_task;
-      infocb->info_list[j].argl = PT[p].argl;
-
-      /*Get the right size so as dont go out o the array borders */
-      real_arg = (PT[p].argl <= PROCINFO_MAX_ARGS_SIZE) ? PT[p].argl : PROCINFO_MAX_ARGS_SIZE; 
-      memcpy(infocb->info_list[j].args, PT[p].args, real_arg); //copy the memory
-  
-      infocb->elements++;
-      j++;
-    }
-    
-  }
+  /*The records are generated lazily, as the reader advances*/
+  rlnode_init(& infocb->cursor, NULL);
+  rlist_push_front(& PCB_list, & infocb->cursor);
 
 	return fid;
 }
@@ -17,6 +17,7 @@
 
 #include "tinyos.h"
 #include "kernel_sched.h"
+#include "kernel_streams.h"
 
 /**
   @brief PID state
@@ -37,6 +38,7 @@ typedef enum pid_state_e {
  */
 typedef struct process_control_block {
   pid_state  pstate;      /**< The pid state for this PCB */
+  Pid_t pid;              /**< The pid of this PCB, fixed when its chunk is allocated */
 
   PCB* parent;            /**< Parent's pcb. */
   int exitval;            /**< The exit value */
@@ -53,20 +55,48 @@ typedef struct process_control_block {
   rlnode exited_node;     /**< Intrusive node for @c exited_list */
   CondVar child_exit;     /**< Condition variable for @c WaitChild */
 
-  FCB* FIDT[MAX_FILEID];  /**< The fileid table of the process */
+  FIDT* fidt;             /**< The fileid table of the process, maybe shared, or NULL if empty */
 
   rlnode ptcb_list;       /*The list with the PTCBs */  
+  rlnode* ptcb_hash;      /**< Buckets of the PTCBs, indexed by Tid, or NULL if empty */
+  unsigned int ptcb_hash_size; /**< The number of buckets, a power of 2 */
+  unsigned int ptcb_count;     /**< The number of PTCBs in @c ptcb_hash */
+  Tid_t next_tid;         /**< The Tid of the next thread of the process */
+  CondVar thread_exit;    /**< Broadcast when a thread exits, for @c ThreadJoinAny and @c WaitAny */
+  unsigned int thread_exit_waiters; /**< The number of threads waiting on @c thread_exit */
+
+  uint64_t tls_keys;      /**< Bitmap of the thread-local storage keys in use */
+  tls_destructor* tls_dtors; /**< The destructors of the keys, or NULL if no key was created */
   
   int active_threads;     /*The number of active threads of the process*/
 
+  rlnode pt_node;         /**< Intrusive node for the list of used PCBs */
+
+  rusage usage;           /**< Resource usage of this process */
+  rusage children_usage;  /**< Resource usage of the reaped descendants */
+
 } PCB;
 
 
+/**
+  @brief The control block of an information stream.
+
+  The cursor is a node placed in the list of used PCBs, right after
+  the last PCB reported to the reader. Cursor nodes are recognized by
+  a @c NULL key.
+*/
+typedef struct System_Information_Control_Block{ 
+  rlnode cursor;          /**< The position of the reader in the list of used PCBs */
+}SICB;
+
+
 /**
   @brief Initialize the process table.
 
   This function is called during kernel initialization, to initialize
   any data structures related to process creation.
+  The PCBs themselves are allocated lazily, in chunks, as processes
+  are created.
 */
 void initialize_processes();
 
@@ -99,6 +99,43 @@ void* allocate_thread(size_t size)
 
 
 
+/*
+  A cache of released thread blocks (TCB plus stack). Threads spawned 
+  by Exec and CreateThread reuse these warm blocks, instead of going 
+  to the allocator for every new thread.
+ */
+#define THREAD_CACHE_SIZE 64
+
+static void* thread_cache[THREAD_CACHE_SIZE];
+static unsigned int thread_cache_count = 0;
+static Mutex thread_cache_spinlock = MUTEX_INIT;
+
+static void* acquire_thread_block()
+{
+  void* ptr = NULL;
+
+  Mutex_Lock(&thread_cache_spinlock);
+  if(thread_cache_count > 0)
+    ptr = thread_cache[--thread_cache_count];
+  Mutex_Unlock(&thread_cache_spinlock);
+
+  return (ptr != NULL) ? ptr : allocate_thread(THREAD_SIZE);
+}
+
+static void release_thread_block(void* ptr)
+{
+  Mutex_Lock(&thread_cache_spinlock);
+  if(thread_cache_count < THREAD_CACHE_SIZE) {
+    thread_cache[thread_cache_count++] = ptr;
+    ptr = NULL;
+  }
+  Mutex_Unlock(&thread_cache_spinlock);
+
+  if(ptr != NULL)
+    free_thread(ptr, THREAD_SIZE);
+}
+
+
 /*
   This is the function that is used to start normal threads.
 */
@@ -122,7 +159,7 @@ static void thread_start()
 TCB* spawn_thread(PCB* pcb, void (*func)())
 {
   /* The allocated thread size must be a multiple of page size */
-  TCB* tcb = (TCB*) allocate_thread(THREAD_SIZE);
+  TCB* tcb = (TCB*) acquire_thread_block();
 
   /* Set the owner */
   tcb->owner_pcb = pcb;
@@ -133,7 +170,9 @@ TCB* spawn_thread(PCB* pcb, void (*func)())
   tcb->phase = CTX_CLEAN;
   tcb->thread_func = func;
   tcb->wakeup_time = NO_TIMEOUT;
+  tcb->slice_start = 0;
   tcb->priority = 0;
+  tcb->nonblock_call = 0;
   rlnode_init(& tcb->sched_node, tcb);  /* Intrusive list node */
 
 
@@ -166,7 +205,7 @@ void release_TCB(TCB* tcb)
   VALGRIND_STACK_DEREGISTER(tcb->valgrind_stack_id);    
 #endif
 
-  free_thread(tcb, THREAD_SIZE);
+  release_thread_block(tcb);
 
   Mutex_Lock(&active_threads_spinlock);
   active_threads--;
@@ -195,21 +234,139 @@ CCB cctx[MAX_CORES];
   head and tail of this list are stored in  SCHED.
 	
   Also, the scheduler contains a linked list of all the sleeping
-  threads with a timeout.
+  threads with a timeout, and a linked list of the armed kernel 
+  timers, both sorted by time.
 
-  Both of these structures are protected by @c sched_spinlock.
+  All of these structures are protected by @c sched_spinlock.
 */
 
 rlnode SCHED[LEVELS];                   /* The scheduler queue */
 rlnode TIMEOUT_LIST;				  /* The list of threads with a timeout */
+rlnode TIMER_LIST;				  /* The list of armed kernel timers */
 Mutex sched_spinlock = MUTEX_INIT;    /* spinlock for scheduler queue */
 
 
+/*
+  Kernel timers.
+*/
+
+void sched_timer_init(sched_timer* timer, void (*expire)(sched_timer*), void* data)
+{
+  rlnode_init(& timer->node, timer);
+  timer->expiry = NO_TIMEOUT;
+  timer->expire = expire;
+  timer->data = data;
+  timer->running = 0;
+}
+
+/* 
+  Disarm a timer.
+
+  *** MUST BE CALLED WITH sched_spinlock HELD ***
+*/
+static void sched_timer_remove(sched_timer* timer)
+{
+  if(timer->expiry != NO_TIMEOUT) {
+    rlist_remove(& timer->node);
+    timer->expiry = NO_TIMEOUT;
+  }
+}
+
+void sched_timer_arm(sched_timer* timer, TimerDuration expiry)
+{
+  int preempt = preempt_off;
+  Mutex_Lock(& sched_spinlock);
+
+  sched_timer_remove(timer);
+  timer->expiry = expiry;
+
+  /* add to the TIMER_LIST in sorted order */
+  rlnode* n = TIMER_LIST.next;
+  for( ; n!=&TIMER_LIST; n=n->next) 
+    if(expiry < n->timer->expiry) break;
+  rl_splice(n->prev, & timer->node);
+
+  Mutex_Unlock(& sched_spinlock);
+
+  /* Bring the alarm of this core forward, if needed. Other cores see
+     the timer when their current alarm goes off */
+  TimerDuration now = bios_clock();
+  TimerDuration delta = (expiry > now + MIN_ALARM) ? expiry - now : MIN_ALARM;
+  TimerDuration left = bios_set_timer(delta);
+  if(left > 0 && left < delta) bios_set_timer(left);
+
+  if(preempt) preempt_on;
+}
+
+void sched_timer_cancel(sched_timer* timer)
+{
+  int preempt = preempt_off;
+  Mutex_Lock(& sched_spinlock);
+
+  /* The function may arm the timer again, so remove it when it is done */
+  while(timer->running) {
+    Mutex_Unlock(& sched_spinlock);
+    Mutex_Lock(& sched_spinlock);
+  }
+  sched_timer_remove(timer);
+
+  Mutex_Unlock(& sched_spinlock);
+  if(preempt) preempt_on;
+}
+
+/* Call the functions of the expired timers. Called from the ALARM handler */
+static void sched_run_timers()
+{
+  int preempt = preempt_off;
+  Mutex_Lock(& sched_spinlock);
+
+  TimerDuration curtime = bios_clock();
+  while(! is_rlist_empty(&TIMER_LIST)) {
+    sched_timer* timer = TIMER_LIST.next->timer;
+    if(timer->expiry > curtime)
+      break;
+    sched_timer_remove(timer);
+
+    /* Call the function without the lock, it may wake up threads or arm the timer */
+    timer->running = 1;
+    Mutex_Unlock(& sched_spinlock);
+    timer->expire(timer);
+    Mutex_Lock(& sched_spinlock);
+    timer->running = 0;
+  }
+
+  Mutex_Unlock(& sched_spinlock);
+  if(preempt) preempt_on;
+}
+
+/* 
+  The interval until the next alarm of this core: the end of the quantum,
+  or the earliest timeout, if it comes first.
+
+  *** MUST BE CALLED WITH sched_spinlock HELD ***
+*/
+static TimerDuration sched_next_alarm()
+{
+  TimerDuration next = bios_clock() + QUANTUM;
+  if(! is_rlist_empty(&TIMEOUT_LIST) && TIMEOUT_LIST.next->tcb->wakeup_time < next)
+    next = TIMEOUT_LIST.next->tcb->wakeup_time;
+  if(! is_rlist_empty(&TIMER_LIST) && TIMER_LIST.next->timer->expiry < next)
+    next = TIMER_LIST.next->timer->expiry;
+
+  TimerDuration curtime = bios_clock();
+  return (next > curtime + MIN_ALARM) ? next - curtime : MIN_ALARM;
+}
+
+
 
 /* Interrupt handler for ALARM */
 void yield_handler()
 {
-  yield(SCHED_QUANTUM);
+  sched_run_timers();
+
+  /* The alarm may have come early, for a timeout */
+  TCB* current = CURTHREAD;
+  yield((bios_clock() - current->slice_start >= QUANTUM) ? SCHED_QUANTUM : SCHED_TIMER);
 }
 
 /* Interrupt handle for inter-core interrupts */
@@ -355,6 +512,34 @@ int wakeup(TCB* tcb)
 }
 
 
+/*
+  Make a list of new threads ready, in one batch. 
+ */
+int wakeup_many(rlnode* tcbs)
+{
+	int ret = 0;
+
+	/* Preemption off */
+	int oldpre = preempt_off;
+
+	Mutex_Lock(& sched_spinlock);
+
+	while(! is_rlist_empty(tcbs)) {
+		TCB* tcb = rlist_pop_front(tcbs)->tcb;
+		assert(tcb->state==INIT);
+		sched_make_ready(tcb);
+		ret++;
+	}
+
+	Mutex_Unlock(& sched_spinlock);
+
+	/* Restore preemption state */
+	if(oldpre) preempt_on;
+
+	return ret;
+}
+
+
 /*
   Atomically put the current process to sleep, after unlocking mx.
  */
@@ -372,6 +557,14 @@ void sleep_releasing(Thread_state state, Mutex* mx, enum SCHED_CAUSE cause, Time
   int preempt = preempt_off;
   Mutex_Lock(& sched_spinlock);
 
+  /* An exited thread charges its last timeslice here, since its process 
+     may be reaped as soon as mx is released, before yield() runs */
+  if(state==EXITED) {
+    PCB* pcb = tcb->owner_pcb;
+    pcb->usage.cpu_time += bios_clock() - tcb->slice_start;
+    pcb->usage.context_switches++;
+  }
+
   /* mark the thread as stopped or exited */
   tcb->state = state;
 
@@ -450,6 +643,7 @@ void yield(enum SCHED_CAUSE cause)
     case SCHED_POLL:
     case SCHED_IDLE:
     case SCHED_USER:
+    case SCHED_TIMER:
       break;
     default:
       fprintf(stderr, "BAD CAUSE for current thread %p in yield: %d\n", current, cause);
@@ -473,6 +667,15 @@ void yield(enum SCHED_CAUSE cause)
       next = & CURCORE.idle_thread;
   }
 
+  /* Charge the timeslice to the process. Exited threads have done so in 
+     sleep_releasing(), and their process may already be reaped */
+  if(current->type != IDLE_THREAD && current->state != EXITED) {
+    PCB* pcb = current->owner_pcb;
+    pcb->usage.cpu_time += bios_clock() - current->slice_start;
+    if(current != next)
+      pcb->usage.context_switches++;
+  }
+
   /* ok, link the current and next TCB, for the gain phase */
   current->next = next;
   next->prev = current;
@@ -514,6 +717,7 @@ void gain(int preempt)
 
   current->state = RUNNING;
   current->phase = CTX_DIRTY;
+  current->slice_start = bios_clock();
 
   if(current != prev) {
   	/* Take care of the previous thread */
@@ -533,13 +737,14 @@ void gain(int preempt)
     }
   }
 
+  /* Set a 1-quantum alarm, or an earlier one for the next timeout, 
+     before preemption is on, so that a stale alarm is dropped */
+  bios_set_timer(sched_next_alarm());
+
   Mutex_Unlock(& sched_spinlock);
 
   /* Reset preemption as needed */
   if(preempt) preempt_on;
-
-  /* Set a 1-quantum alarm */
-  bios_set_timer(QUANTUM);
 }
 
 
@@ -570,6 +775,7 @@ void initialize_scheduler()
       rlnode_init(&SCHED[i], NULL);
     }  
   rlnode_init(&TIMEOUT_LIST, NULL);
+  rlnode_init(&TIMER_LIST, NULL);
 }
 
 
@@ -74,7 +74,8 @@ enum SCHED_CAUSE {
   SCHED_PIPE,     /**< Sleep at a pipe or socket */
   SCHED_POLL,     /**< The thread is polling a device */
   SCHED_IDLE,     /**< The idle thread called yield */
-  SCHED_USER      /**< User-space code called yield */
+  SCHED_USER,     /**< User-space code called yield */
+  SCHED_TIMER     /**< A timer expired before the quantum */
 };
 
 #define LEVELS 3 /** Priority Levels */
@@ -98,6 +99,9 @@ typedef struct pt_control_block{
   int joinable;   /*If the thread is joinable is 1 otherwise is 0*/
   Tid_t tid;      /*The id of the thread*/
   rlnode node;    /*The node of the PTCB*/
+  rlnode hash_node; /*The node in the Tid hash table of the process*/
+  void** tls;     /*The thread-local storage values, or NULL if none was set*/
+  future_t* future; /*The future to complete when the thread exits, or NULL*/
   int ref_counter;/*Count how many thread have accessed the ptcb*/ 
 
 }PTCB;
@@ -127,12 +131,15 @@ typedef struct thread_control_block
   void (*thread_func)();   /**< The function executed by this thread */
 
   TimerDuration wakeup_time; /**< The time this thread will be woken up by the scheduler */
+  TimerDuration slice_start; /**< The time the current timeslice of this thread started */
   rlnode sched_node;      /**< node to use when queueing in the scheduler lists */
 
   struct thread_control_block * prev;  /**< previous context */
   struct thread_control_block * next;  /**< next context */
 
   int priority; /**The scheduling priortiy of the thread */  
+
+  int nonblock_call; /**< The current system call must not block, see @c FCB_nonblock */
   
 } TCB;
 
@@ -192,6 +199,26 @@ extern CCB cctx[MAX_CORES];
 #define NO_TIMEOUT ((TimerDuration)-1)
 
 
+/**
+  @brief The deadline of a system call timeout, in milliseconds from now.
+
+  A timeout of `(timeout_t)-1` means no deadline, and so does a timeout 
+  that is too long to be represented, instead of wrapping around.
+
+  @param timeout the timeout of a system call
+  @returns the time of the deadline, or @c NO_TIMEOUT
+*/
+static inline TimerDuration timeout_deadline(timeout_t timeout)
+{
+  if(timeout == (timeout_t)-1)
+    return NO_TIMEOUT;
+  TimerDuration now = bios_clock();
+  if(timeout >= (NO_TIMEOUT - now) / 1000ul)
+    return NO_TIMEOUT;
+  return now + timeout*1000ul;
+}
+
+
 /**
   @brief Create a new thread.
 
@@ -214,6 +241,19 @@ TCB* spawn_thread(PCB* pcb, void (*func)());
 */
 int wakeup(TCB* tcb);
 
+/**
+  @brief Wakeup a batch of new threads.
+
+  This call makes @c READY all the threads in list @c tcbs, taking the
+  scheduler lock only once. The threads must be in the @c INIT state,
+  and they are linked in the list through their @c sched_node. 
+  The list is empty when the call returns.
+
+  @param tcbs the list of threads to be made @c READY.
+  @returns the number of threads made @c READY.
+*/
+int wakeup_many(rlnode* tcbs);
+
 
 /** 
   @brief Block the current thread.
@@ -256,6 +296,46 @@ void sleep_releasing(Thread_state newstate, Mutex* mx, enum SCHED_CAUSE cause, T
  */
 void yield(enum SCHED_CAUSE cause);
 
+
+/**
+  @brief A kernel timer.
+
+  A kernel timer calls a function at a given time, without a thread
+  waiting for it. Armed timers are kept by the scheduler, next to the 
+  sleeping threads with a timeout, and the alarm of each core is set 
+  for the earliest of them, if it comes before the end of the quantum.
+
+  The function is called from the ALARM interrupt handler, with 
+  preemption off. It must not block or take the kernel lock, but it may
+  signal condition variables and arm the timer again.
+ */
+typedef struct sched_timer {
+  rlnode node;                /**< @brief The node in the list of armed timers */
+  TimerDuration expiry;       /**< @brief The time of expiry, or @c NO_TIMEOUT if not armed */
+  void (*expire)(struct sched_timer* timer);  /**< @brief Called at expiry */
+  void* data;                 /**< @brief Data for @c expire */
+  sig_atomic_t running;       /**< @brief Set while @c expire runs */
+} sched_timer;
+
+/** @brief Initialize a timer, which is not armed */
+void sched_timer_init(sched_timer* timer, void (*expire)(sched_timer*), void* data);
+
+/** 
+  @brief Arm a timer to expire at time @c expiry, as returned by @c bios_clock.
+
+  A timer that is already armed is moved to the new time. 
+ */
+void sched_timer_arm(sched_timer* timer, TimerDuration expiry);
+
+/** 
+  @brief Disarm a timer.
+
+  If the timer function is running on another core, wait for it to return.
+  After this call, the function will not be called, unless the timer 
+  is armed again.
+ */
+void sched_timer_cancel(sched_timer* timer);
+
 /**
   @brief Enter the scheduler.
 
@@ -286,6 +366,14 @@ void priority_booster(void);
   */
 #define QUANTUM (10000L)
 
+/**
+  @brief The shortest alarm (in microseconds)
+
+  An alarm for a timeout or a kernel timer is not set earlier than this,
+  so that the ALARM handler, which may yield, returns before the next one.
+  */
+#define MIN_ALARM (100L)
+
 /** @} */
 
 
@@ -46,6 +46,9 @@ typedef struct socket_control_block
 	SST struct_type;    //the extra fields that we use (for peer or listener)
 	port_t port;        //the preferred port
 	int ref_counter;    //the number of the pointers to this socket	
+	unsigned int lowat; //the low-water mark for reading
+	rlnode pollers;     //the poll list of a listener, or of a socket that connects
+	struct connection_request* pending;  //the request of a non-blocking Connect, until it is served
 }SOCKETCB;
 
 /*The request control block */
@@ -61,13 +64,43 @@ typedef struct connection_request
 /*The Port Map*/
 SOCKETCB* PORT_MAP[MAX_PORT+1];
 
-/*Read data from the pipe 
-Returns the size that we read on success, otherwise 0*/
+/*Read data from the socket, as soon as at least its low-water mark is available 
+Returns the size that we read on success, otherwise -1*/
 int socket_read(void* this, char* buf, unsigned int size){
 	SOCKETCB* mysocket = (SOCKETCB*)this;
 
+	if (mysocket->type != PEER)
+		return -1;
+
 	PIPECB* mypipe = mysocket->struct_type.peer_struct.pipe_read; //get the pipe for read
-	return pipe_read(mypipe, buf, size);
+	return pipe_read_lowat(mypipe, buf, size, mysocket->lowat);
+}
+
+/*Read data from the socket into a vector of buffers, like socket_read*/
+static int socket_readv(void* this, const iovec_t* iov, unsigned int iovcnt){
+	SOCKETCB* mysocket = (SOCKETCB*)this;
+
+	if (mysocket->type != PEER)
+		return -1;
+
+	return pipe_readv_lowat(mysocket->struct_type.peer_struct.pipe_read, iov, iovcnt, mysocket->lowat);
+}
+
+/*Set the low-water mark for reading. It is kept by the socket, 
+so it can be set before the socket is connected*/
+static int socket_set_lowat(void* this, unsigned int lowat){
+	SOCKETCB* mysocket = (SOCKETCB*)this;
+	mysocket->lowat = lowat;
+	return 0;
+}
+
+/*Return the pipe that a connected socket reads or writes*/
+static void* socket_get_pipe(void* this, int write){
+	SOCKETCB* mysocket = (SOCKETCB*)this;
+
+	if (mysocket->type != PEER)
+		return NULL;
+	return write ? mysocket->struct_type.peer_struct.pipe_write : mysocket->struct_type.peer_struct.pipe_read;
 }
 
 /*Write data to the socket 
@@ -79,6 +112,36 @@ int socket_write(void* this, const char* buf, unsigned int size){
 	return pipe_write(mypipe, buf, size);
 }
 
+/*Return the events of the socket. A connected socket is polled through its pipes*/
+static int socket_poll(void* this, poll_hook* hook){
+	SOCKETCB* mysocket = (SOCKETCB*)this;
+
+	switch (mysocket->type){
+		case LISTENER:
+			if (hook != NULL)
+				poll_hook_attach(hook, & mysocket->pollers, NULL);
+			return is_rlist_empty(& mysocket->struct_type.listener_struct.queue) ? 0 : POLL_READ;
+		case PEER:
+			return pipe_poll(mysocket->struct_type.peer_struct.pipe_read, 0, mysocket->lowat, hook)
+				| pipe_poll(mysocket->struct_type.peer_struct.pipe_write, 1, 0, hook);
+		default:
+			/*Wait for a non-blocking Connect, else Read and Write fail at once*/
+			if (hook != NULL)
+				poll_hook_attach(hook, & mysocket->pollers, NULL);
+			return (mysocket->pending != NULL) ? 0 : POLL_HANGUP;
+	}
+}
+
+/*Write a vector of buffers to the socket, in one transfer*/
+static int socket_writev(void* this, const iovec_t* iov, unsigned int iovcnt){
+	SOCKETCB* mysocket = (SOCKETCB*)this;
+
+	if (mysocket->type != PEER)
+		return -1;
+
+	return pipe_writev(mysocket->struct_type.peer_struct.pipe_write, iov, iovcnt);
+}
+
 /*Close the writer of the socket 
 Returns 0 on success, otherwise -1*/
 int socket_close(void* this){
@@ -104,6 +167,13 @@ int socket_close(void* this){
 		}
 	}
 
+	/*In case the socket is still connecting, withdraw the request */
+	if (mysocket->type == UNBOUND && mysocket->pending != NULL){
+		rlist_remove(& mysocket->pending->node);
+		free(mysocket->pending);
+		mysocket->pending = NULL;
+	}
+
 	/*In case the socker is listener */
 	if(mysocket->type == LISTENER){
 		rlnode* mynode;
@@ -111,7 +181,16 @@ int socket_close(void* this){
 		/*Reject all the pending requests. In this way Connect function will fail */
 		while(!is_rlist_empty(& mysocket->struct_type.listener_struct.queue)){
 			mynode = rlist_pop_front(& mysocket->struct_type.listener_struct.queue);
-			mynode->request->activeListener = 0;
+			SOCKETCB* connecting = mynode->request->socket_req;
+
+			/*Nobody waits for a non-blocking request, tell the pollers*/
+			if (connecting->pending == mynode->request){
+				connecting->pending = NULL;
+				poll_notify(& connecting->pollers);
+				free(mynode->request);
+			}else{
+				mynode->request->activeListener = 0;
+			}
 		}
 
 		/*Wake up Accept. In this way Accept function will fail */
@@ -137,7 +216,12 @@ static file_ops socketOps = {
 	.Open = NULL,
 	.Read = socket_read,
 	.Write = socket_write,
-	.Close = socket_close
+	.Close = socket_close,
+	.SetLowWater = socket_set_lowat,
+	.GetPipe = socket_get_pipe,
+	.ReadV = socket_readv,
+	.WriteV = socket_writev,
+	.Poll = socket_poll
 };
 
 /* Initialize the socket */
@@ -169,8 +253,12 @@ Fid_t sys_Socket(port_t port)
 
 	mysocket->ref_counter =0;
 	mysocket->port = port;
+	mysocket->lowat = 1;
+	rlnode_init(& mysocket->pollers, NULL);
+	mysocket->pending = NULL;
 	mysocket->fcb->streamobj = mysocket;
 	mysocket->fcb->streamfunc = &socketOps;
+	mysocket->fcb->streamtype = STREAM_SOCKET;
 	mysocket->ref_counter++;
 
 	return mysocket->fid;
@@ -178,22 +266,17 @@ Fid_t sys_Socket(port_t port)
 
 int sys_Listen(Fid_t sock)
 {
-	PCB* pcb = CURPROC;
 	SOCKETCB* mysocket;
 	
 	/* Check if the file id is legal*/
-	if (sock < 0 || sock > MAX_FILEID){	
+	FCB* fcb = get_fcb(sock);
+	if (fcb == NULL){
 		return -1;
-	}else{
-		/* Check if the socket is bound to a port*/
-		if (pcb->FIDT[sock] == NULL){
-			return -1;
-		}
 	}
 	/* Get the socket object */
-	if (pcb->FIDT[sock]->streamfunc == &socketOps)
+	if (fcb->streamfunc == &socketOps)
 	{
-		mysocket = pcb->FIDT[sock]->streamobj;
+		mysocket = fcb->streamobj;
 		if (mysocket->port == NOFILE)
 		{
 			return -1;
@@ -229,19 +312,15 @@ int sys_Listen(Fid_t sock)
 Fid_t sys_Accept(Fid_t lsock)
 {
 	/*Checks if the file id is legal*/
-	if (lsock < 0 || lsock > MAX_FILEID)
+	FCB* lfcb = get_fcb(lsock);
+	if (lfcb == NULL)
 	{	
 		return NOFILE;
-	}else{
-		if (CURPROC->FIDT[lsock] == NULL)
-		{
-			return NOFILE;
-		}
 	}
 	SOCKETCB* listener;
-	if (CURPROC->FIDT[lsock]->streamfunc == &socketOps)
+	if (lfcb->streamfunc == &socketOps)
 	{
-		listener = CURPROC->FIDT[lsock]->streamobj;
+		listener = lfcb->streamobj;
 		if (listener->port == NOFILE)
 		{
 			return NOFILE;
@@ -263,17 +342,33 @@ Fid_t sys_Accept(Fid_t lsock)
 	REQUESTCB* myrequest = NULL;
 	port_t lport = listener->port;
 
-	/*Check if there is a request */
+	/*Check if there is a request. The socket is kept while we wait, since
+	  lsock may be closed meanwhile, and with it the socket and its FCB */
+	int closed = 0;
+	listener->ref_counter++;
 	while(is_rlist_empty(& listener->struct_type.listener_struct.queue))
 	{	
+		/*The socket is still open, so lfcb is valid*/
+		if (FCB_nonblock(lfcb))
+			break;
+
 		/* Check if while waiting, the listening socket lsock was closed*/
-		kernel_wait(& listener->struct_type.listener_struct.cv, SCHED_USER);
+		stream_wait(& listener->struct_type.listener_struct.cv, NO_TIMEOUT);
 
-		if (PORT_MAP[lport] == NULL)
+		if (PORT_MAP[lport] != listener)
 		{
-			return NOFILE;
+			closed = 1;
+			break;
 		}
 	}
+
+	int empty = is_rlist_empty(& listener->struct_type.listener_struct.queue);
+	if (--listener->ref_counter <= 0)
+		free(listener);
+	if (closed)
+		return NOFILE;
+	if (empty)
+		return WOULD_BLOCK;
 		
 	request_node = rlist_pop_front(& listener->struct_type.listener_struct.queue);
 	myrequest = request_node->request;
@@ -286,7 +381,7 @@ Fid_t sys_Accept(Fid_t lsock)
 	{
 		return NOFILE;
 	}
-	server_socket = CURPROC->FIDT[server_id]->streamobj;
+	server_socket = get_fcb(server_id)->streamobj;
 
 	pipe1 = init_pipe();
 	pipe2 = init_pipe();
@@ -319,32 +414,34 @@ Fid_t sys_Accept(Fid_t lsock)
 	myrequest->served = 1;
 	peer->ref_counter++;
 	server_socket->ref_counter++;
-	kernel_broadcast(& myrequest->cv);
+	if (peer->pending == myrequest){
+		/*A non-blocking Connect returned already, its socket is now writable*/
+		peer->pending = NULL;
+		free(myrequest);
+		poll_notify(& peer->pollers);
+	}else{
+		kernel_broadcast(& myrequest->cv);
+	}
 
 	return server_socket->fid;
 }
 
 int sys_Connect(Fid_t sock, port_t port, timeout_t timeout)
 {
-	PCB* pcb = CURPROC;
 	SOCKETCB* peer;
 
 	/** Tests for our socket **/
 	/* Check for ligal FID*/
 	/* Check is smth is bounded to this port */
-	if (sock < 0 || sock > MAX_FILEID)
+	FCB* fcb = get_fcb(sock);
+	if (fcb == NULL)
 	{
 		return -1;
-	}else{
-		if (pcb->FIDT[sock] == NULL)
-		{
-			return -1;
-		}
 	}
 	/* Check is a socket is bounded to this FID*/
-	if (pcb->FIDT[sock]->streamfunc == &socketOps)
+	if (fcb->streamfunc == &socketOps)
 	{
-		peer = pcb->FIDT[sock]->streamobj;
+		peer = fcb->streamobj;
 
 		/*Check if this port our socket has an port*/
 	}else{
@@ -352,7 +449,7 @@ int sys_Connect(Fid_t sock, port_t port, timeout_t timeout)
 	}
 	port_t myport = peer->port;
 	/*Check if there is a listener at the port that we want to connect*/
-	if (PORT_MAP[myport] != NULL || peer->type != UNBOUND)
+	if (PORT_MAP[myport] != NULL || peer->type != UNBOUND || peer->pending != NULL)
 	{
 		return -1;
 	}
@@ -387,7 +484,16 @@ int sys_Connect(Fid_t sock, port_t port, timeout_t timeout)
 
 	/*Sleep */
 	kernel_broadcast(& listener->struct_type.listener_struct.cv);
-	kernel_timedwait(& myrequest->cv, SCHED_USER, timeout);
+	poll_notify(& listener->pollers);
+
+	/* A non-blocking Connect leaves the request to the listener */
+	if (FCB_nonblock(fcb)){
+		peer->pending = myrequest;
+		return WOULD_BLOCK;
+	}
+
+	/* The timeout is given in msec, a negative timeout means no timeout */
+	stream_wait(& myrequest->cv, (timeout==(timeout_t)-1) ? NO_TIMEOUT : timeout*1000ul);
 
 	/* Check is the request is served */
 	if(myrequest->served == 0 || myrequest->activeListener == 0){
@@ -401,20 +507,19 @@ int sys_Connect(Fid_t sock, port_t port, timeout_t timeout)
 int sys_ShutDown(Fid_t sock, shutdown_mode how)
 {	
 	/*Check if there is a valic id*/
-	if (sock < 0 || sock > MAX_FILEID){
+	FCB* fcb = get_fcb(sock);
+	if (fcb == NULL){
 		return -1;
-	}else{
-		if (CURPROC->FIDT[sock] == NULL){
-			return -1;
-		}
 	}
 	/*Check if there is a socket*/
 	SOCKETCB* mysocket;
-	if (CURPROC->FIDT[sock]->streamfunc == &socketOps){
-		mysocket = CURPROC->FIDT[sock]->streamobj;
+	if (fcb->streamfunc == &socketOps){
+		mysocket = fcb->streamobj;
 		if (mysocket->port == NOFILE){
 			return -1;
 		}
+	}else{
+		return -1;
 	}
 
 	SOCKETCB* peer = mysocket->struct_type.peer_struct.peer;
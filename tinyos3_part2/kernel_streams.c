@@ -1,34 +1,70 @@
 
+#include <limits.h>
 #include "util.h"
 #include "tinyos.h"
 #include "kernel_cc.h"
 #include "kernel_streams.h"
 #include "kernel_sched.h"
 #include "kernel_proc.h"
+#include "kernel_pipe.h"
 
 #define MAX_FILES MAX_PROC
 
-FCB FT[MAX_FILES];
+/* 
+  The file table is allocated on demand, in chunks of FT_CHUNK_SIZE FCBs,
+  when the free list of FCBs runs out.
+ */
+#define FT_CHUNK_SIZE 256
+#define FT_CHUNKS (MAX_FILES/FT_CHUNK_SIZE)
+
+static FCB* FT[FT_CHUNKS];
+static unsigned int ft_chunks;     /* The number of allocated chunks */
 rlnode FCB_freelist;
 
 
+/* Allocate the next chunk of the file table. Returns 0 if the table is full. */
+static int grow_file_table()
+{
+  if(ft_chunks == FT_CHUNKS) return 0;
+
+  FCB* chunk = (FCB*)malloc(FT_CHUNK_SIZE*sizeof(FCB));
+  if(chunk == NULL) return 0;
+
+  for(int i=0;i<FT_CHUNK_SIZE;i++) {
+    chunk[i].refcount = 0;
+    rlnode_init(& chunk[i].freelist_node, &chunk[i]);
+    rlist_push_back(&FCB_freelist, & chunk[i].freelist_node);
+  }
+
+  FT[ft_chunks++] = chunk;
+  return 1;
+}
+
+
 void initialize_files()
 {
   rlnode_init(&FCB_freelist,NULL);
-  for(int i=0;i<MAX_FILES;i++) {
 
-    FT[i].refcount = 0;
-    rlnode_init(& FT[i].freelist_node, &FT[i]);
-    rlist_push_back(&FCB_freelist, & FT[i].freelist_node);
+  /* release the chunks of a previous boot, the rest are allocated on demand */
+  for(unsigned int c=0; c<ft_chunks; c++) {
+    free(FT[c]);
+    FT[c] = NULL;
   }
+  ft_chunks = 0;
 }
 
 
 FCB* acquire_FCB()
 {
+  if(is_rlist_empty(& FCB_freelist))
+    grow_file_table();
+
   if(! is_rlist_empty(& FCB_freelist)) {
     FCB* fcb = rlist_pop_front(& FCB_freelist)->fcb;
     fcb->refcount = 0;
+    fcb->streamtype = STREAM_NULL;
+    fcb->flags = 0;
+    rlnode_init(& fcb->evitems, NULL);
     return fcb;
   }
   else
@@ -52,6 +88,7 @@ int FCB_decref(FCB* fcb)
   assert(fcb);
   fcb->refcount --;
   if(fcb->refcount==0) {
+    evset_forget(fcb);
     int retval = fcb->streamfunc->Close(fcb->streamobj);
     release_FCB(fcb);
     return retval;
@@ -60,22 +97,193 @@ int FCB_decref(FCB* fcb)
     return 0;
 }
 
+int FCB_nonblock(FCB* fcb)
+{
+  if(fcb->flags & FCB_NONBLOCK)
+    return 1;
+
+  /* Read the current thread with preemption off, since the lock-free 
+     paths of pipes call us too */
+  int preempt = preempt_off;
+  int nonblock = CURTHREAD->nonblock_call;
+  if(preempt) preempt_on;
+  return nonblock;
+}
+
+int FCB_would_block(FCB* fcb, int events)
+{
+  if(!FCB_nonblock(fcb) || fcb->streamfunc->Poll == NULL)
+    return 0;
+  return (fcb->streamfunc->Poll(fcb->streamobj, NULL) & (events | POLL_HANGUP)) == 0;
+}
+
+
+
+/*
+ *
+ *   File id tables
+ *
+ */
+
+#define FIDT_WORD_BITS 64
+
+/* Allocate a new, empty and unshared table. Returns NULL if we are out of memory. */
+static FIDT* FIDT_new()
+{
+  FIDT* fidt = (FIDT*)malloc(sizeof(FIDT));
+  if(fidt == NULL) return NULL;
+
+  fidt->refcount = 1;
+  fidt->size = 0;
+  fidt->fcb = NULL;
+  fidt->used = NULL;
+  return fidt;
+}
+
+
+/* 
+  Make sure that fid is inside the table, doubling its size as needed. 
+  Returns 0 if we are out of memory.
+*/
+static int FIDT_grow(FIDT* fidt, Fid_t fid)
+{
+  assert(fid>=0 && fid<MAX_FILEID);
+  if(fid < fidt->size) return 1;
+
+  unsigned int newsize = (fidt->size==0) ? FIDT_WORD_BITS : fidt->size;
+  while(newsize <= fid) newsize *= 2;
+  if(newsize > MAX_FILEID) newsize = MAX_FILEID;
+
+  FCB** newfcb = (FCB**)realloc(fidt->fcb, newsize*sizeof(FCB*));
+  if(newfcb == NULL) return 0;
+  fidt->fcb = newfcb;
+
+  uint64_t* newused = (uint64_t*)realloc(fidt->used, newsize/FIDT_WORD_BITS*sizeof(uint64_t));
+  if(newused == NULL) return 0;
+  fidt->used = newused;
+
+  memset(fidt->fcb + fidt->size, 0, (newsize-fidt->size)*sizeof(FCB*));
+  memset(fidt->used + fidt->size/FIDT_WORD_BITS, 0, 
+    (newsize-fidt->size)/FIDT_WORD_BITS*sizeof(uint64_t));
+  fidt->size = newsize;
+  return 1;
+}
+
+
+/* 
+  Return the lowest free fid which is not less than 'from', 
+  or NOFILE if there is none. The fid may be beyond the current
+  size of the table.
+*/
+static Fid_t FIDT_find_free(FIDT* fidt, Fid_t from)
+{
+  for(unsigned int w = from/FIDT_WORD_BITS; w < fidt->size/FIDT_WORD_BITS; w++) {
+    uint64_t word = fidt->used[w];
+    /* ignore the fids below 'from' */
+    if(w == from/FIDT_WORD_BITS)
+      word |= ((uint64_t)1 << (from % FIDT_WORD_BITS)) - 1;
+    if(~word)
+      return w*FIDT_WORD_BITS + __builtin_ctzll(~word);
+  }
+
+  Fid_t f = (from > fidt->size) ? from : fidt->size;
+  return (f < MAX_FILEID) ? f : NOFILE;
+}
+
+
+/* Store fcb (which may be NULL) at the given fid, which must be inside the table */
+static void FIDT_set(FIDT* fidt, Fid_t fid, FCB* fcb)
+{
+  uint64_t bit = (uint64_t)1 << (fid % FIDT_WORD_BITS);
+  fidt->fcb[fid] = fcb;
+  if(fcb)
+    fidt->used[fid/FIDT_WORD_BITS] |= bit;
+  else
+    fidt->used[fid/FIDT_WORD_BITS] &= ~bit;
+}
+
+
+FIDT* FIDT_share(FIDT* fidt)
+{
+  if(fidt != NULL)
+    fidt->refcount++;
+  return fidt;
+}
+
+
+void FIDT_release(FIDT* fidt)
+{
+  if(fidt == NULL) return;
+
+  fidt->refcount--;
+  if(fidt->refcount > 0) return;
+
+  for(unsigned int i=0; i<fidt->size; i++) {
+    if(fidt->fcb[i] != NULL) {
+      FCB* fcb = fidt->fcb[i];
+      FIDT_set(fidt, i, NULL);
+      FCB_decref(fcb);
+    }
+  }
+
+  free(fidt->fcb);
+  free(fidt->used);
+  free(fidt);
+}
+
+
+/*
+  Return the table of the current process, ready to be modified.
+  If the table is shared, the process gets its own copy first. 
+  Returns NULL if we are out of memory.
+*/
+static FIDT* FIDT_writable()
+{
+  PCB* cur = CURPROC;
+  FIDT* fidt = cur->fidt;
+
+  if(fidt != NULL && fidt->refcount == 1)
+    return fidt;
+
+  FIDT* copy = FIDT_new();
+  if(copy == NULL) return NULL;
+
+  if(fidt != NULL && fidt->size > 0) {
+    if(! FIDT_grow(copy, fidt->size-1)) {
+      FIDT_release(copy);
+      return NULL;
+    }
+    memcpy(copy->fcb, fidt->fcb, fidt->size*sizeof(FCB*));
+    memcpy(copy->used, fidt->used, fidt->size/FIDT_WORD_BITS*sizeof(uint64_t));
+
+    for(unsigned int i=0; i<copy->size; i++)
+      if(copy->fcb[i])
+        FCB_incref(copy->fcb[i]);
+  }
+
+  FIDT_release(fidt);
+  cur->fidt = copy;
+  return copy;
+}
+
 
 
 int FCB_reserve(size_t num, Fid_t *fid, FCB** fcb)
 {
-    PCB* cur = CURPROC;
-    size_t f=0;
+    FIDT* fidt = FIDT_writable();
+    if(fidt == NULL) return 0;
+    Fid_t f=0;
     uint i;
     /* Find distinct fids */
     for(i=0; i<num; i++) {
-	    while(f<MAX_FILEID && cur->FIDT[f]!=NULL)
-	      f++;
-	    if(f==MAX_FILEID) break;
+	    f = FIDT_find_free(fidt, f);
+	    if(f==NOFILE) break;
 	    fid[i] = f; 
       f++;
     }
     if(i<num) return 0;
+    /* Make room for the fids in the table */
+    if(num>0 && !FIDT_grow(fidt, fid[num-1])) return 0;
     /* Allocate FCBs */
     for(i=0;i<num;i++)
 	    if((fcb[i] = acquire_FCB()) == NULL)
@@ -90,7 +298,7 @@ int FCB_reserve(size_t num, Fid_t *fid, FCB** fcb)
     }
     /* Found all */
     for(i=0;i<num;i++) {
-    	cur->FIDT[fid[i]]=fcb[i];
+    	FIDT_set(fidt, fid[i], fcb[i]);
     	FCB_incref(fcb[i]);
     }
     return 1;
@@ -100,10 +308,10 @@ int FCB_reserve(size_t num, Fid_t *fid, FCB** fcb)
 
 void FCB_unreserve(size_t num, Fid_t *fid, FCB** fcb)
 {
-    PCB* cur = CURPROC;
+    FIDT* fidt = CURPROC->fidt;   /* made writable by FCB_reserve */
     for(size_t i=0; i<num ; i++) {
-	assert(cur->FIDT[fid[i]]==fcb[i]);
-	cur->FIDT[fid[i]] = NULL;
+	assert(fidt->fcb[fid[i]]==fcb[i]);
+	FIDT_set(fidt, fid[i], NULL);
 	release_FCB(fcb[i]);
     }
 }
@@ -122,9 +330,36 @@ void FCB_unreserve(size_t num, Fid_t *fid, FCB** fcb)
 
 FCB* get_fcb(Fid_t fid)
 {
-  if(fid < 0 || fid >= MAX_FILEID) return NULL;
+  FIDT* fidt = CURPROC->fidt;
+  if(fidt == NULL || fid < 0 || fid >= fidt->size) return NULL;
+
+  return fidt->fcb[fid];
+}
+
+
+int sys_SetLowWater(Fid_t fd, unsigned int lowat)
+{
+  FCB* fcb = get_fcb(fd);
+
+  if(fcb == NULL || lowat == 0 || fcb->streamfunc->SetLowWater == NULL)
+    return -1;
+
+  return fcb->streamfunc->SetLowWater(fcb->streamobj, lowat);
+}
+
+
+int sys_SetNonBlock(Fid_t fd, int nonblock)
+{
+  FCB* fcb = get_fcb(fd);
+
+  if(fcb == NULL)
+    return -1;
 
-  return CURPROC->FIDT[fid];
+  if(nonblock)
+    fcb->flags |= FCB_NONBLOCK;
+  else
+    fcb->flags &= ~FCB_NONBLOCK;
+  return 0;
 }
 
 
@@ -146,9 +381,14 @@ int sys_Read(Fid_t fd, char *buf, unsigned int size)
        while we are using it! */
     FCB_incref(fcb);
   
-    if(devread)
+    if(FCB_would_block(fcb, POLL_READ))
+      retcode = WOULD_BLOCK;
+    else if(devread)
       retcode = devread(sobj, buf, size);
 
+    if(retcode > 0)
+      CURPROC->usage.bytes_read[fcb->streamtype] += retcode;
+
     /* Need to decrease the reference to FCB */
     FCB_decref(fcb);
   }
@@ -180,9 +420,14 @@ int sys_Write(Fid_t fd, const char *buf, unsigned int size)
     FCB_incref(fcb);
   
 
-    if(devwrite)
+    if(FCB_would_block(fcb, POLL_WRITE))
+      retcode = WOULD_BLOCK;
+    else if(devwrite)
       retcode = devwrite(sobj, buf, size);
 
+    if(retcode > 0)
+      CURPROC->usage.bytes_written[fcb->streamtype] += retcode;
+
     /* Need to decrease the reference to FCB */
     FCB_decref(fcb);
 
@@ -193,6 +438,204 @@ int sys_Write(Fid_t fd, const char *buf, unsigned int size)
 }
 
 
+int sys_ReadNonBlock(Fid_t fd, char *buf, unsigned int size)
+{
+  CURTHREAD->nonblock_call = 1;
+  int retcode = sys_Read(fd, buf, size);
+  CURTHREAD->nonblock_call = 0;
+  return retcode;
+}
+
+
+int sys_WriteNonBlock(Fid_t fd, const char *buf, unsigned int size)
+{
+  CURTHREAD->nonblock_call = 1;
+  int retcode = sys_Write(fd, buf, size);
+  CURTHREAD->nonblock_call = 0;
+  return retcode;
+}
+
+
+/* Check the buffers of a vectored call. Returns 0 if they are not valid */
+static int iov_valid(const iovec_t* iov, unsigned int iovcnt)
+{
+  if(iov == NULL || iovcnt > MAX_IOV)
+    return 0;
+
+  /* The result must fit in an int */
+  unsigned long total = 0;
+  for(unsigned int i=0; i<iovcnt; i++)
+    total += iov[i].len;
+  return total <= INT_MAX;
+}
+
+
+int sys_ReadV(Fid_t fd, const iovec_t* iov, unsigned int iovcnt)
+{
+  int retcode = -1;
+
+  FCB* fcb = get_fcb(fd);
+
+  if(fcb && iov_valid(iov, iovcnt)) {
+    FCB_incref(fcb);
+
+    if(FCB_would_block(fcb, POLL_READ))
+      retcode = WOULD_BLOCK;
+    else if(fcb->streamfunc->ReadV) 
+      retcode = fcb->streamfunc->ReadV(fcb->streamobj, iov, iovcnt);
+    else if(fcb->streamfunc->Read) {
+      /* Read the buffers one by one, up to the first short read, or until it would block */
+      retcode = 0;
+      for(unsigned int i=0; i<iovcnt; i++) {
+        if(i > 0 && FCB_would_block(fcb, POLL_READ)) break;
+        int rc = fcb->streamfunc->Read(fcb->streamobj, iov[i].base, iov[i].len);
+        if(rc < 0) {
+          if(retcode == 0) retcode = -1;
+          break;
+        }
+        retcode += rc;
+        if((unsigned int)rc < iov[i].len) break;
+      }
+    }
+
+    if(retcode > 0)
+      CURPROC->usage.bytes_read[fcb->streamtype] += retcode;
+
+    FCB_decref(fcb);
+  }
+
+  return retcode;
+}
+
+
+int sys_WriteV(Fid_t fd, const iovec_t* iov, unsigned int iovcnt)
+{
+  int retcode = -1;
+
+  FCB* fcb = get_fcb(fd);
+
+  if(fcb && iov_valid(iov, iovcnt)) {
+    FCB_incref(fcb);
+
+    if(FCB_would_block(fcb, POLL_WRITE))
+      retcode = WOULD_BLOCK;
+    else if(fcb->streamfunc->WriteV) 
+      retcode = fcb->streamfunc->WriteV(fcb->streamobj, iov, iovcnt);
+    else if(fcb->streamfunc->Write) {
+      /* Write the buffers one by one, up to the first short write, or until it would block */
+      retcode = 0;
+      for(unsigned int i=0; i<iovcnt; i++) {
+        if(i > 0 && FCB_would_block(fcb, POLL_WRITE)) break;
+        int rc = fcb->streamfunc->Write(fcb->streamobj, iov[i].base, iov[i].len);
+        if(rc < 0) {
+          if(retcode == 0) retcode = -1;
+          break;
+        }
+        retcode += rc;
+        if((unsigned int)rc < iov[i].len) break;
+      }
+    }
+
+    if(retcode > 0)
+      CURPROC->usage.bytes_written[fcb->streamtype] += retcode;
+
+    FCB_decref(fcb);
+  }
+
+  return retcode;
+}
+
+
+/* The state of a file id in Poll */
+typedef struct poll_entry {
+  FCB* fcb;            /* The stream, or NULL if the file id is not valid */
+  poll_hook hook;      /* Wakes up the polling thread */
+} poll_entry;
+
+/* The polling thread. Streams can notify it from interrupt handlers, 
+   so a notification is recorded before the CondVar is signalled */
+typedef struct poll_waiter {
+  CondVar cv;
+  volatile sig_atomic_t fired;
+} poll_waiter;
+
+static void poll_wakeup(poll_hook* hook)
+{
+  poll_waiter* w = (poll_waiter*) hook->data;
+  w->fired = 1;
+  Cond_Broadcast(& w->cv);
+}
+
+/* Set the events of the file ids, attaching the hooks if asked to.
+   Returns the number of file ids with some event */
+static int poll_scan(pollfd_t* fds, poll_entry* ent, unsigned int nfds, int attach)
+{
+  int ready = 0;
+  for(unsigned int i=0; i<nfds; i++) {
+    FCB* fcb = ent[i].fcb;
+    poll_hook* hook = attach ? & ent[i].hook : NULL;
+
+    if(fds[i].fd == NOFILE)
+      fds[i].revents = 0;
+    else if(fcb == NULL)
+      fds[i].revents = POLL_INVALID;
+    else if(fcb->streamfunc->Poll)
+      fds[i].revents = fcb->streamfunc->Poll(fcb->streamobj, hook) & (fds[i].events | POLL_HANGUP);
+    else
+      fds[i].revents = (POLL_READ | POLL_WRITE) & fds[i].events;
+
+    if(fds[i].revents) ready++;
+  }
+  return ready;
+}
+
+
+int sys_Poll(pollfd_t* fds, unsigned int nfds, timeout_t timeout)
+{
+  if(fds == NULL || nfds > MAX_FILEID)
+    return -1;
+
+  poll_entry* ent = (poll_entry*) malloc(nfds * sizeof(poll_entry) + 1);
+  if(ent == NULL)
+    return -1;
+
+  poll_waiter waiter = { .cv = COND_INIT, .fired = 0 };
+  TimerDuration deadline = timeout_deadline(timeout);
+
+  /* make sure that the streams will not be closed (by another thread) 
+     while we are using them! */
+  for(unsigned int i=0; i<nfds; i++) {
+    ent[i].fcb = (fds[i].fd == NOFILE) ? NULL : get_fcb(fds[i].fd);
+    if(ent[i].fcb) FCB_incref(ent[i].fcb);
+    poll_hook_init(& ent[i].hook, poll_wakeup, & waiter);
+  }
+
+  int ready = poll_scan(fds, ent, nfds, 0);
+
+  if(ready == 0 && timeout != 0) {
+    /* Attach the hooks and check again, before we sleep */
+    ready = poll_scan(fds, ent, nfds, 1);
+    while(ready == 0) {
+      TimerDuration now = bios_clock();
+      if(deadline != NO_TIMEOUT && now >= deadline) 
+        break;
+      stream_wait_event(& waiter.cv, & waiter.fired, (deadline == NO_TIMEOUT) ? NO_TIMEOUT : deadline - now);
+      waiter.fired = 0;
+      ready = poll_scan(fds, ent, nfds, 0);
+    }
+
+    for(unsigned int i=0; i<nfds; i++)
+      poll_hook_detach(& ent[i].hook);
+  }
+
+  for(unsigned int i=0; i<nfds; i++)
+    if(ent[i].fcb) FCB_decref(ent[i].fcb);
+  free(ent);
+
+  return ready;
+}
+
+
 int sys_Close(int fd)
 {
   int retcode = (fd>=0 && fd<MAX_FILEID) ? 0 : -1;  /* Closing a closed fd is legal! */
@@ -200,7 +643,9 @@ int sys_Close(int fd)
   FCB* fcb = get_fcb(fd);
 
   if(fcb) {
-    CURPROC->FIDT[fd] = NULL;
+    FIDT* fidt = FIDT_writable();
+    if(fidt == NULL) return -1;
+    FIDT_set(fidt, fd, NULL);
     retcode = FCB_decref(fcb);    
   }
 
@@ -228,10 +673,13 @@ int sys_Dup2(int oldfd, int newfd)
     retcode = -1;
   }
   else if(old!=new) {
+    FIDT* fidt = FIDT_writable();
+    if(fidt == NULL || ! FIDT_grow(fidt, newfd))
+      return -1;
     if(new)
       FCB_decref(new);
     FCB_incref(old);
-    CURPROC->FIDT[newfd] = old;
+    FIDT_set(fidt, newfd, old);
   }
 
   return retcode;
@@ -261,6 +709,7 @@ Fid_t open_stream(Device_type major, unsigned int minor)
       FCB_unreserve(1, &fid, &fcb);
       goto finerr;
   }
+  fcb->streamtype = (major==DEV_SERIAL) ? STREAM_TERMINAL : STREAM_NULL;
   
   goto finok;
 finerr:
@@ -43,9 +43,36 @@ typedef struct file_control_block
   uint refcount;  			/**< @brief Reference counter. */
   void* streamobj;			/**< @brief The stream object (e.g., a device) */
   file_ops* streamfunc;		/**< @brief The stream implementation methods */
+  stream_type streamtype;	/**< @brief The stream type, for resource accounting */
+  unsigned int flags;		/**< @brief The flags of the stream, see @c FCB_NONBLOCK */
+  rlnode evitems;			/**< @brief The registrations of the stream in event sets */
   rlnode freelist_node;		/**< @brief Intrusive list node */
 } FCB;
 
+/** @brief The flag of a stream in non-blocking mode. @see SetNonBlock */
+#define FCB_NONBLOCK 1
+
+
+
+/** @brief The file id table of a process.
+
+	The table starts empty and grows on demand, doubling its size, up to
+	@c MAX_FILEID fids. A bitmap of the used fids is kept along with the
+	FCB pointers, so that the lowest free fid is found with a
+	find-first-zero scan over 64-bit words.
+
+	A table may be shared by many processes: a new process shares the 
+	table of its parent, and a private copy is made (copy-on-write) 
+	when one of the sharers first modifies it. A shared table holds 
+	a single reference to each of its FCBs.
+ */
+typedef struct fid_table
+{
+  uint refcount;			/**< @brief The number of processes sharing the table */
+  unsigned int size;		/**< @brief The number of fids in the table, a multiple of 64 */
+  FCB** fcb;				/**< @brief The FCB of each fid, or NULL for a free fid */
+  uint64_t* used;			/**< @brief The bitmap of used fids */
+} FIDT;
 
 
 /** 
@@ -78,6 +105,69 @@ void FCB_incref(FCB* fcb);
 int FCB_decref(FCB* fcb);
 
 
+/**
+	@brief Remove a stream from the event sets it is registered with.
+
+	This is called by @c FCB_decref when the last reference to the 
+	stream is dropped, before the stream is closed.
+
+	@param fcb the fcb of the stream
+*/
+void evset_forget(FCB* fcb);
+
+
+/**
+	@brief Check if an operation on a stream must not block.
+
+	This is the case when the stream is in non-blocking mode (see 
+	@c SetNonBlock), or when the current system call is a 
+	@c ReadNonBlock or @c WriteNonBlock.
+
+	@param fcb the fcb of the stream
+	@returns 1 if the operation must return @c WOULD_BLOCK instead of waiting, else 0
+*/
+int FCB_nonblock(FCB* fcb);
+
+
+/**
+	@brief Check if a non-blocking stream would block.
+
+	Streams are checked through their @c Poll method. Streams without one
+	never block.
+
+	@param fcb the fcb of the stream
+	@param events the events that the operation needs, @c POLL_READ or @c POLL_WRITE
+	@returns 1 if the stream is in non-blocking mode and none of @c events or 
+	    @c POLL_HANGUP is reported, else 0
+*/
+int FCB_would_block(FCB* fcb, int events);
+
+
+/**
+	@brief Share a file id table.
+
+	The reference count of the table is increased, and the table is
+	returned. A process that modifies a shared table first makes its own
+	copy of it.
+
+	@param fidt the table to share, or NULL for an empty table
+	@returns the shared table
+*/
+FIDT* FIDT_share(FIDT* fidt);
+
+
+/**
+	@brief Stop sharing a file id table.
+
+	The reference count of the table is decreased. If it drops to 0, 
+	the reference count of every FCB in the table is decreased and 
+	the table is freed.
+
+	@param fidt the table to release, or NULL for an empty table
+*/
+void FIDT_release(FIDT* fidt);
+
+
 /** @brief Acquire a number of FCBs and corresponding fids.
 
    Given an array of fids and an array of pointers to FCBs  of
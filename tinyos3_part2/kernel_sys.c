@@ -2,6 +2,7 @@
 #include "tinyos.h"
 #include "kernel_sys.h"
 #include "kernel_cc.h"
+#include "kernel_proc.h"
 
 #ifndef NVALGRIND
 #include <valgrind/valgrind.h>
@@ -12,8 +13,17 @@
  */
 
 
+/* Count the system calls of the current process. There is no
+   current process while the kernel is booting. */
+static inline void count_syscall()
+{
+	if(CURTHREAD != NULL && CURPROC != NULL)
+		CURPROC->usage.syscalls++;
+}
+
 #define PRE_CALL \
 kernel_lock();\
+count_syscall();\
 
 
 
@@ -6,29 +6,56 @@
 
 #define SYSCALLS \
 SYSCALL(Exec, int, (Task task, int argl, void* args), (task, argl, args))\
+SYSCALL(ExecMany, int, (Task task, unsigned int n, int argl, void* args, Pid_t* pids), (task, n, argl, args, pids))\
 SYSCALLV(Exit, (int exitval), (exitval))\
 SYSCALL(GetPid, int, (void), ())\
 SYSCALL(GetPPid, int, (void), ())\
 SYSCALL(WaitChild, Pid_t, (Pid_t proc, int* exitval), (proc, exitval))\
+SYSCALL(WaitChildren, int, (Pid_t* pids, int* statuses, unsigned int n, timeout_t timeout), (pids, statuses, n, timeout))\
 SYSCALL(CreateThread, Tid_t, (Task task, int argl, void* args), (task, argl, args))\
 SYSCALL(ThreadSelf, Tid_t, (void), ())\
 SYSCALL(ThreadJoin, int, (Tid_t tid, int* exitval), (tid, exitval))\
 SYSCALL(ThreadDetach, int, (Tid_t tid), (tid))\
+SYSCALL(ThreadJoinAny, Tid_t, (const Tid_t* tids, unsigned int n, int* exitval), (tids, n, exitval))\
+SYSCALL(CreateThreadFuture, Tid_t, (Task task, int argl, void* args, future_t* future), (task, argl, args, future))\
+SYSCALL(WaitAny, int, (future_t** futures, unsigned int n, timeout_t timeout), (futures, n, timeout))\
 SYSCALLV(ThreadExit, (int exitval), (exitval))\
+SYSCALL(TLSKeyCreate, int, (tls_key_t* key, tls_destructor dtor), (key, dtor))\
+SYSCALL(TLSKeyDelete, int, (tls_key_t key), (key))\
 SYSCALL(GetTerminalDevices, unsigned int, (), ())\
 SYSCALL(OpenTerminal, Fid_t, (unsigned int termno), (termno))\
 SYSCALL(OpenNull, Fid_t, (), ())\
 SYSCALL(Read,int,(Fid_t fd, char *buf, unsigned int size), (fd,buf,size))\
+SYSCALL(SetLowWater,int,(Fid_t fd, unsigned int lowat), (fd,lowat))\
+SYSCALL(SetNonBlock,int,(Fid_t fd, int nonblock), (fd,nonblock))\
+SYSCALL(ReadNonBlock,int,(Fid_t fd, char *buf, unsigned int size), (fd,buf,size))\
+SYSCALL(WriteNonBlock,int,(Fid_t fd, const char *buf, unsigned int size), (fd,buf,size))\
 SYSCALL(Write,int,(Fid_t fd, const char *buf, unsigned int size), (fd,buf,size))\
+SYSCALL(ReadV,int,(Fid_t fd, const iovec_t* iov, unsigned int iovcnt), (fd,iov,iovcnt))\
+SYSCALL(WriteV,int,(Fid_t fd, const iovec_t* iov, unsigned int iovcnt), (fd,iov,iovcnt))\
+SYSCALL(Poll,int,(pollfd_t* fds, unsigned int nfds, timeout_t timeout), (fds,nfds,timeout))\
+SYSCALL(Splice,int,(Fid_t fd_in, Fid_t fd_out, unsigned int len), (fd_in,fd_out,len))\
 SYSCALL(Close,int,(Fid_t fd),(fd))\
 SYSCALL(Dup2,int, (Fid_t oldfd, Fid_t newfd), (oldfd,newfd))\
 SYSCALL(Pipe, int, (pipe_t* pipe), (pipe))\
+SYSCALL(SetPipeSize, int, (Fid_t fd, unsigned int size), (fd,size))\
 SYSCALL(Socket, Fid_t, (port_t port), (port))\
 SYSCALL(Listen, int, (Fid_t sock), (sock))\
 SYSCALL(Accept, Fid_t, (Fid_t lsock), (lsock))\
 SYSCALL(Connect, int, (Fid_t sock, port_t port, timeout_t timeout), (sock, port, timeout))\
 SYSCALL(ShutDown, int, (Fid_t sock, shutdown_mode how), (sock, how))\
+SYSCALL(MsgQueue, Fid_t, (unsigned int maxmsg, unsigned int msgsize), (maxmsg, msgsize))\
+SYSCALL(MsgSend, int, (Fid_t fd, const void* msg, unsigned int len, unsigned int prio), (fd, msg, len, prio))\
+SYSCALL(MsgReceive, int, (Fid_t fd, void* buf, unsigned int size, unsigned int* prio), (fd, buf, size, prio))\
+SYSCALL(EventSet, Fid_t, (), ())\
+SYSCALL(EventCtl, int, (Fid_t evset, event_op op, Fid_t fd, int events), (evset, op, fd, events))\
+SYSCALL(EventWait, int, (Fid_t evset, event_t* events, unsigned int maxevents, timeout_t timeout), (evset, events, maxevents, timeout))\
+SYSCALL(EventFd, Fid_t, (unsigned int initval, int flags), (initval, flags))\
+SYSCALLV(Sleep, (unsigned long usec), (usec))\
+SYSCALL(Timer, Fid_t, (unsigned long initial, unsigned long period), (initial, period))\
+SYSCALL(TimerSet, int, (Fid_t fd, unsigned long initial, unsigned long period), (fd, initial, period))\
 SYSCALL(OpenInfo, Fid_t, (), ())\
+SYSCALL(GetRusage, int, (rusage_who who, rusage* usage), (who, usage))\
 
 
 
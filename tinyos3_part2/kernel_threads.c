@@ -3,19 +3,161 @@
 #include "kernel_sched.h"
 #include "kernel_proc.h"
 #include "kernel_cc.h"
+#include "kernel_threads.h"
+
+/*
+  Released PTCBs are kept in a free list and reused by 
+  CreateThread and Exec, instead of going back to malloc.
+*/
+#define PTCB_FREELIST_MAX 1024
+
+static rlnode ptcb_freelist = { .obj=NULL, .prev=&ptcb_freelist, .next=&ptcb_freelist };
+static unsigned int ptcb_freelist_count = 0;
+
+/*
+  Each process keeps a hash table of its PTCBs, indexed by Tid, so that
+  ThreadJoin and ThreadDetach do not have to scan the PTCB list.
+  Tids are allocated sequentially per process, so the low bits of the Tid
+  spread the PTCBs evenly over the buckets. The table doubles when the
+  number of PTCBs exceeds twice the number of buckets.
+*/
+#define PTCB_HASH_INITIAL_SIZE 16
+
+/* Insert a PTCB in the hash table of its process. Returns 0 if we are out of memory. */
+static int ptcb_hash_insert(PCB* pcb, PTCB* ptcb)
+{
+  /* Allocate or grow the table as needed */
+  if(pcb->ptcb_hash == NULL || pcb->ptcb_count >= 2*pcb->ptcb_hash_size) {
+    unsigned int newsize = (pcb->ptcb_hash == NULL) ? PTCB_HASH_INITIAL_SIZE : 2*pcb->ptcb_hash_size;
+    rlnode* newhash = (rlnode*)malloc(newsize*sizeof(rlnode));
+    if(newhash == NULL) return 0;
+
+    for(unsigned int i=0; i<newsize; i++)
+      rlnode_init(&newhash[i], NULL);
+
+    /* Move the PTCBs to the new buckets */
+    for(unsigned int i=0; i<pcb->ptcb_hash_size; i++) {
+      while(! is_rlist_empty(&pcb->ptcb_hash[i])) {
+        rlnode* node = rlist_pop_front(&pcb->ptcb_hash[i]);
+        rlist_push_back(&newhash[node->ptcb->tid & (newsize-1)], node);
+      }
+    }
+
+    free(pcb->ptcb_hash);
+    pcb->ptcb_hash = newhash;
+    pcb->ptcb_hash_size = newsize;
+  }
+
+  rlnode_init(&ptcb->hash_node, ptcb);
+  rlist_push_back(&pcb->ptcb_hash[ptcb->tid & (pcb->ptcb_hash_size-1)], &ptcb->hash_node);
+  pcb->ptcb_count++;
+  return 1;
+}
+
+/* Find the PTCB of a thread of the process, or return NULL */
+static PTCB* ptcb_hash_find(PCB* pcb, Tid_t tid)
+{
+  if(pcb->ptcb_hash == NULL) return NULL;
+
+  rlnode* bucket = &pcb->ptcb_hash[tid & (pcb->ptcb_hash_size-1)];
+  for(rlnode* node = bucket->next; node != bucket; node = node->next)
+    if(node->ptcb->tid == tid)
+      return node->ptcb;
+
+  return NULL;
+}
+
+PTCB* acquire_PTCB(PCB* pcb, Task task, int argl, void* args)
+{
+  PTCB* myptcb;
+
+  if(! is_rlist_empty(&ptcb_freelist)) {
+    myptcb = rlist_pop_front(&ptcb_freelist)->ptcb;
+    ptcb_freelist_count--;
+  }
+  else {
+    myptcb = (struct pt_control_block*)malloc(sizeof(struct pt_control_block));
+    if (myptcb == NULL)
+      return NULL;
+  }
+
+  /* Initializing the PTCB*/
+  myptcb->cv = COND_INIT;
+  myptcb->task = task;
+  myptcb->argl = argl;
+  myptcb->args = args;
+  myptcb->pcb = pcb;
+  myptcb->tcb = NULL;
+  myptcb->joinable = 1;
+  myptcb->exited = 0;
+  myptcb->ref_counter = 0;
+  myptcb->tid = pcb->next_tid;
+  myptcb->tls = NULL;
+  myptcb->future = NULL;
+
+  /*Add the PTCB to the hash table of the process*/
+  if(! ptcb_hash_insert(pcb, myptcb)) {
+    free(myptcb);
+    return NULL;
+  }
+  pcb->next_tid++;
+
+  /*Add the node to the ptcb list*/
+  rlnode_init(&(myptcb->node), myptcb);
+  rlist_push_back(&(pcb->ptcb_list), &(myptcb->node));
+
+  return myptcb;
+}
 
 /*Delete the PTCB*/
-void release_PTCB(rlnode* node){
-  free(node->ptcb);
-  rlist_remove(node);
+void release_PTCB(PTCB* ptcb){
+  rlist_remove(& ptcb->node);
+  rlist_remove(& ptcb->hash_node);
+  ptcb->pcb->ptcb_count--;
+  free(ptcb->tls);
+  ptcb->tls = NULL;
+
+  if(ptcb_freelist_count < PTCB_FREELIST_MAX) {
+    rlist_push_front(&ptcb_freelist, & ptcb->node);
+    ptcb_freelist_count++;
+  }
+  else
+    free(ptcb);
+}
+
+void initialize_PTCB_table(PCB* pcb)
+{
+  pcb->next_tid = 1;     /* The main thread gets Tid 1 */
+  pcb->ptcb_hash = NULL;
+  pcb->ptcb_hash_size = 0;
+  pcb->ptcb_count = 0;
+  rlnode_init(& pcb->ptcb_list, NULL);
+  pcb->tls_keys = 0;
+  pcb->tls_dtors = NULL;
+  pcb->thread_exit = COND_INIT;
+  pcb->thread_exit_waiters = 0;
 }
 
-/* This function generates IDs for TCBs*/
-Tid_t id_generator(){
+void cleanup_PTCB_table(PCB* pcb)
+{
+  rlnode* node = pcb->ptcb_list.next;
+  while(node != & pcb->ptcb_list) {
+    PTCB* ptcb = node->ptcb;
+    node = node->next;
+    if(ptcb->exited)
+      release_PTCB(ptcb);  /* Recycle the PTCBs of the exited threads */
+    else
+      rlnode_init(& ptcb->hash_node, ptcb);  /* Unhook it from the buckets freed below */
+  }
 
-  static unsigned int id = 2; /*ID = 1 is the main thread*/
+  free(pcb->ptcb_hash);
+  pcb->ptcb_hash = NULL;
+  pcb->ptcb_hash_size = 0;
+  pcb->next_tid = 1;
 
-  return (Tid_t)id++;
+  free(pcb->tls_dtors);
+  pcb->tls_dtors = NULL;
+  pcb->tls_keys = 0;
 }
 
 /*The Main function of every TCB*/
@@ -30,16 +172,13 @@ void start_thread()
 }
 
 
-/** 
-  @brief Create a new thread in the current process.
-  */
-Tid_t sys_CreateThread(Task task, int argl, void* args)
+/* Create a new thread in the current process. If future is not NULL,
+   the thread is detached and completes the future when it exits. */
+static Tid_t create_thread(Task task, int argl, void* args, future_t* future)
 {
-
   PCB* pcb = CURPROC;  
-
   /* Create the PTCB */
-  PTCB* myptcb = (struct pt_control_block*)malloc(sizeof(struct pt_control_block));
+  PTCB* myptcb = acquire_PTCB(pcb, task, argl, args);
   
   if (myptcb == NULL)
   {
@@ -47,16 +186,11 @@ Tid_t sys_CreateThread(Task task, int argl, void* args)
     return NOTHREAD;
   }
 
-  /* Initializing the PTCB*/
-  myptcb->cv = COND_INIT;
-  myptcb->task = task;
-  myptcb->argl = argl;
-  myptcb->args = args;
-  myptcb->pcb = pcb;
-  myptcb->joinable = 1;
-  myptcb->exited = 0;
-  myptcb->tid = id_generator();
-  myptcb->ref_counter = 0;
+  if (future != NULL){
+    future->done = 0;
+    myptcb->future = future;
+    myptcb->joinable = 0;
+  }
 
   /*Create the Thread*/
   TCB* tcb = spawn_thread(pcb, start_thread);
@@ -65,20 +199,33 @@ Tid_t sys_CreateThread(Task task, int argl, void* args)
   myptcb->tcb = tcb;
   tcb->owner_ptcb = myptcb;
 
-  /*Link PTCB with PCB */
-  /*Create the node of ptcb*/
-  rlnode_init(&(myptcb->node), myptcb); 
-
-  /*Add the node to the ptcb list*/
-  rlist_push_back(&(pcb->ptcb_list), &(myptcb->node)); 
-
   pcb->active_threads++; /*It counts the active threads of the pcb*/
+  if(pcb->active_threads > pcb->usage.peak_threads)
+    pcb->usage.peak_threads = pcb->active_threads;
 
   wakeup(tcb); /*Make the thread READY for scheduling*/
 
   return (Tid_t)myptcb->tid;
 }
 
+/** 
+  @brief Create a new thread in the current process.
+  */
+Tid_t sys_CreateThread(Task task, int argl, void* args)
+{
+  return create_thread(task, argl, args, NULL);
+}
+
+/**
+  @brief Create a new detached thread, whose exit completes a future.
+  */
+Tid_t sys_CreateThreadFuture(Task task, int argl, void* args, future_t* future)
+{
+  if(future == NULL)
+    return NOTHREAD;
+  return create_thread(task, argl, args, future);
+}
+
 /**
   @brief Return the Tid of the current thread.
  */
@@ -96,62 +243,270 @@ int sys_ThreadJoin(Tid_t tid, int* exitval)
   if(sys_ThreadSelf() == tid){
     return -1;
   }
-  PCB* pcb = CURPROC;
-  rlnode* ptcb_node = & pcb->ptcb_list; /*this is the head of ptcb list*/
-
-  while(ptcb_node != NULL){ /* Check if there is a node*/
-    if (ptcb_node->ptcb->tid == tid){ /* Check if the ID is found*/
-      if (ptcb_node->ptcb->joinable == 0) /*Check it is joinable*/
-      {
-        return -1;
-      }else{
-        /*Count how many threads wait for this TCB*/
-        ptcb_node->ptcb->ref_counter++;
-        while(ptcb_node->ptcb->exited == 0){ /*Check is the thread has finished*/
-          kernel_wait(&(ptcb_node->ptcb->cv), SCHED_USER);
-        }
-      }
-      
-      if(exitval != NULL){
-        *exitval = ptcb_node->ptcb->exitval; /*save the exit value*/
-      }
-      ptcb_node->ptcb->ref_counter--;
-      /*Check if there are other thread that wait the specific
-      exit value. If not, delete the PTCB*/ 
-      if(ptcb_node->ptcb->ref_counter <= 0){
-        release_PTCB(ptcb_node);
-      }
-      return 0; 
-    }
 
-    ptcb_node = ptcb_node->next;
+  PTCB* ptcb = ptcb_hash_find(CURPROC, tid);
+
+  /* Check if the ID is found and it is joinable*/
+  if (ptcb == NULL || ptcb->joinable == 0){
+    return -1;
   }
-  return -1;
+
+  /*Count how many threads wait for this TCB*/
+  ptcb->ref_counter++;
+  while(ptcb->exited == 0){ /*Check is the thread has finished*/
+    kernel_wait(&(ptcb->cv), SCHED_USER);
+  }
+
+  if(exitval != NULL){
+    *exitval = ptcb->exitval; /*save the exit value*/
+  }
+  ptcb->ref_counter--;
+  /*Check if there are other thread that wait the specific
+  exit value. If not, delete the PTCB*/ 
+  if(ptcb->ref_counter <= 0){
+    release_PTCB(ptcb);
+  }
+  return 0; 
 }
 
 /**
   @brief Detach the given thread.
   */
 int sys_ThreadDetach(Tid_t tid)
+{
+  PTCB* ptcb = ptcb_hash_find(CURPROC, tid);
+
+  /*Only a thread which has not exited can be detached*/
+  if (ptcb == NULL || ptcb->exited != 0){
+    return -1;
+  }
+
+  ptcb->joinable = 0;
+  return 0;
+}
+
+/* Wait until some thread of the current process exits, or the deadline passes.
+   Returns 0 if the deadline has passed. */
+static int wait_thread_exit(PCB* pcb, TimerDuration deadline)
+{
+  int ret = 1;
+  pcb->thread_exit_waiters++;
+  if(deadline == NO_TIMEOUT)
+    kernel_wait(& pcb->thread_exit, SCHED_USER);
+  else {
+    TimerDuration now = bios_clock();
+    if(now >= deadline) 
+      ret = 0;
+    else
+      kernel_timedwait(& pcb->thread_exit, SCHED_USER, deadline-now);
+  }
+  pcb->thread_exit_waiters--;
+  return ret;
+}
+
+/* Order PTCB pointers by address, for qsort */
+static int compare_ptcb_ptr(const void* a, const void* b)
+{
+  uintptr_t x = (uintptr_t) *(PTCB* const*)a;
+  uintptr_t y = (uintptr_t) *(PTCB* const*)b;
+  return (x > y) - (x < y);
+}
+
+/**
+  @brief Join any one of the given threads.
+  */
+Tid_t sys_ThreadJoinAny(const Tid_t* tids, unsigned int n, int* exitval)
 {
   PCB* pcb = CURPROC;
-  rlnode* ptcb_node = &(pcb->ptcb_list);
-
-/*Search the tid and make it detachable*/
-  while(ptcb_node != NULL){
-    if (ptcb_node->ptcb->tid == tid){
-      if (ptcb_node->ptcb->exited == 0)
-      {
-        ptcb_node->ptcb->joinable = 0;
-        return 0;
-      }
+
+  if(tids == NULL || n == 0)
+    return NOTHREAD;
+
+  /* n comes from the user, so the array is not on the kernel stack */
+  PTCB** ptcbs = (PTCB**)malloc(n * sizeof(PTCB*));
+  if(ptcbs == NULL)
+    return NOTHREAD;
+
+  Tid_t self = sys_ThreadSelf();
+  for(unsigned int i=0; i<n; i++) {
+    ptcbs[i] = ptcb_hash_find(pcb, tids[i]);
+    if(tids[i] == self || ptcbs[i] == NULL || ptcbs[i]->joinable == 0) {
+      free(ptcbs);
+      return NOTHREAD;
     }
-    ptcb_node = ptcb_node->next;   
   }
 
+  /* Keep the PTCBs while we wait */
+  for(unsigned int i=0; i<n; i++)
+    ptcbs[i]->ref_counter++;
+
+  PTCB* joined = NULL;
+  while(1) {
+    for(unsigned int i=0; i<n && joined == NULL; i++)
+      if(ptcbs[i]->exited) joined = ptcbs[i];
+    if(joined != NULL) break;
+    wait_thread_exit(pcb, NO_TIMEOUT);
+  }
+
+  Tid_t tid = joined->tid;
+  if(exitval != NULL)
+    *exitval = joined->exitval;
+
+  /* Drop our references. Threads that were detached while we waited
+     and have exited are released, as ThreadExit could not do it. 
+     The same tid may appear many times, so sort to group them. */
+  for(unsigned int i=0; i<n; i++)
+    ptcbs[i]->ref_counter--;
+  qsort(ptcbs, n, sizeof(PTCB*), compare_ptcb_ptr);
+  for(unsigned int i=0; i<n; i++) {
+    PTCB* ptcb = ptcbs[i];
+    if(i+1 < n && ptcbs[i+1] == ptcb) continue;
+    if(ptcb->ref_counter <= 0 && ptcb->exited && (ptcb == joined || ptcb->joinable == 0))
+      release_PTCB(ptcb);
+  }
+
+  free(ptcbs);
+  return tid;
+}
+
+/**
+  @brief Wait for any one of the given futures to complete.
+  */
+int sys_WaitAny(future_t** futures, unsigned int n, timeout_t timeout)
+{
+  PCB* pcb = CURPROC;
+
+  if(futures == NULL || n == 0)
+    return -1;
+
+  TimerDuration deadline = timeout_deadline(timeout);
+  do {
+    for(unsigned int i=0; i<n; i++)
+      if(futures[i] != NULL && futures[i]->done)
+        return i;
+  } while(wait_thread_exit(pcb, deadline));
+
   return -1;
 }
 
+/*
+  Thread-local storage.
+
+  The values of a thread are kept in an array of its PTCB, allocated
+  on the first TLSSet. TLSGet and TLSSet only touch the current thread,
+  so they do not take the kernel lock.
+*/
+
+/* The number of times the destructors are run, if they keep setting values */
+#define TLS_DESTRUCTOR_ITERATIONS 4
+
+#define TLS_KEY_BIT(key) (((uint64_t)1) << (key))
+
+int sys_TLSKeyCreate(tls_key_t* key, tls_destructor dtor)
+{
+  PCB* pcb = CURPROC;
+
+  if(key == NULL || pcb->tls_keys == ~((uint64_t)0))
+    return -1;
+
+  if(pcb->tls_dtors == NULL) {
+    pcb->tls_dtors = (tls_destructor*)calloc(MAX_TLS_KEYS, sizeof(tls_destructor));
+    if(pcb->tls_dtors == NULL)
+      return -1;
+  }
+
+  tls_key_t k = __builtin_ctzll(~pcb->tls_keys);
+  pcb->tls_keys |= TLS_KEY_BIT(k);
+  pcb->tls_dtors[k] = dtor;
+  *key = k;
+  return 0;
+}
+
+int sys_TLSKeyDelete(tls_key_t key)
+{
+  PCB* pcb = CURPROC;
+
+  if(key >= MAX_TLS_KEYS || !(pcb->tls_keys & TLS_KEY_BIT(key)))
+    return -1;
+
+  pcb->tls_keys &= ~TLS_KEY_BIT(key);
+  pcb->tls_dtors[key] = NULL;
+
+  /* Clear the values of the threads, so that a key created later
+     does not return them */
+  for(rlnode* n = pcb->ptcb_list.next; n != & pcb->ptcb_list; n = n->next) {
+    PTCB* ptcb = n->ptcb;
+    if(ptcb->tls != NULL)
+      ptcb->tls[key] = NULL;
+  }
+  return 0;
+}
+
+/*
+  Return the current thread without entering the kernel. Preemption is 
+  off between reading the core id and the thread of the core, so that 
+  we cannot move to another core in between.
+*/
+static inline TCB* tls_current_thread()
+{
+  int preempt = preempt_off;
+  TCB* tcb = CURTHREAD;
+  if(preempt) preempt_on;
+  return tcb;
+}
+
+void* TLSGet(tls_key_t key)
+{
+  if(key >= MAX_TLS_KEYS) return NULL;
+
+  void** tls = tls_current_thread()->owner_ptcb->tls;
+  return (tls == NULL) ? NULL : tls[key];
+}
+
+int TLSSet(tls_key_t key, void* value)
+{
+  TCB* tcb = tls_current_thread();
+
+  if(key >= MAX_TLS_KEYS || !(tcb->owner_pcb->tls_keys & TLS_KEY_BIT(key)))
+    return -1;
+
+  PTCB* ptcb = tcb->owner_ptcb;
+  if(ptcb->tls == NULL) {
+    ptcb->tls = (void**)calloc(MAX_TLS_KEYS, sizeof(void*));
+    if(ptcb->tls == NULL) return -1;
+  }
+  ptcb->tls[key] = value;
+  return 0;
+}
+
+/* Call the destructors of the values of the current thread and free them. 
+   The destructors are called without the kernel lock. */
+static void run_tls_destructors(PCB* pcb, PTCB* ptcb)
+{
+  if(ptcb->tls == NULL) return;
+
+  for(int pass=0; pass < TLS_DESTRUCTOR_ITERATIONS; pass++) {
+    int called = 0;
+    for(tls_key_t key=0; key < MAX_TLS_KEYS; key++) {
+      void* value = ptcb->tls[key];
+      if(value == NULL || !(pcb->tls_keys & TLS_KEY_BIT(key)) || pcb->tls_dtors[key] == NULL)
+        continue;
+
+      tls_destructor dtor = pcb->tls_dtors[key];
+      ptcb->tls[key] = NULL;
+      kernel_unlock();
+      dtor(value);
+      kernel_lock();
+      called = 1;
+    }
+    if(! called) break;
+  }
+
+  free(ptcb->tls);
+  ptcb->tls = NULL;
+}
+
+
 /**
   @brief Terminate the current thread.
   */
@@ -159,19 +514,33 @@ void sys_ThreadExit(int exitval)
 {
   TCB* tcb = CURTHREAD;
   PTCB* myptcb = tcb->owner_ptcb;
+  run_tls_destructors(CURPROC, myptcb);
+
   myptcb->exitval = exitval; /*Save the exitval to PTCB for Join*/
   myptcb->tcb = NULL;
   myptcb->exited = 1; /*Mark the thread as exited*/
+  if (myptcb->future != NULL){ /*Complete the future*/
+    myptcb->future->exitval = exitval;
+    myptcb->future->done = 1;
+  }
 
   /*Reduce the number of active threads of the process*/
   CURPROC->active_threads--; 
   kernel_broadcast(&(myptcb->cv)); /*Wake up ThreadJoin*/
+  if (CURPROC->thread_exit_waiters > 0)
+    kernel_broadcast(& CURPROC->thread_exit); /*Wake up ThreadJoinAny and WaitAny*/
 
   /*If the thread is the last one of this process, call Exit,
   otherwise relase the TCB*/
   if (CURPROC->active_threads <= 0){
     sys_Exit(exitval);
   }else{
+    /*Nobody can join a detached thread, so reclaim its PTCB now,
+    unless some threads were already waiting for it*/
+    if (myptcb->joinable == 0 && myptcb->ref_counter <= 0){
+      release_PTCB(myptcb);
+      tcb->owner_ptcb = NULL;
+    }
     kernel_sleep(EXITED,SCHED_USER);
   }
 }
@@ -0,0 +1,76 @@
+#ifndef __KERNEL_THREADS_H
+#define __KERNEL_THREADS_H
+
+/**
+  @file kernel_threads.h
+  @brief Process threads.
+
+  @defgroup threads Threads
+  @ingroup kernel
+  @brief Process threads.
+
+  This file declares the helpers used to manage the PTCBs
+  of process threads.
+
+  @{
+*/
+
+#include "tinyos.h"
+#include "kernel_sched.h"
+#include "kernel_proc.h"
+
+/**
+  @brief Acquire and initialize a PTCB.
+
+  The PTCB is taken from a free list of recycled PTCBs, or allocated
+  if the free list is empty. It gets the next Tid of @c pcb, and it is
+  added to the PTCB list and the Tid hash table of @c pcb.
+  The caller must link it to its TCB.
+
+  Must be called with kernel_mutex held.
+
+  @param pcb the owner process
+  @param task the task of the thread
+  @param argl the argument length of the task
+  @param args the arguments of the task
+  @returns the new PTCB, or NULL if we are out of memory.
+*/
+PTCB* acquire_PTCB(PCB* pcb, Task task, int argl, void* args);
+
+/**
+  @brief Release a PTCB.
+
+  The PTCB is removed from the PTCB list and the Tid hash table of
+  its process and returned to the free list.
+
+  Must be called with kernel_mutex held.
+
+  @param ptcb the PTCB to release
+*/
+void release_PTCB(PTCB* ptcb);
+
+/**
+  @brief Initialize the thread bookkeeping of a process.
+
+  The PTCB list and the Tid hash table of @c pcb are emptied, and Tid
+  allocation restarts at 1, the Tid of the main thread.
+
+  @param pcb the process
+*/
+void initialize_PTCB_table(PCB* pcb);
+
+/**
+  @brief Release the thread bookkeeping of an exited process.
+
+  The PTCBs of the exited threads are released, the Tid hash table
+  of @c pcb is freed and Tid allocation restarts at 1.
+
+  Must be called with kernel_mutex held.
+
+  @param pcb the process
+*/
+void cleanup_PTCB_table(PCB* pcb);
+
+/** @} */
+
+#endif
@@ -0,0 +1,195 @@
+
+#include "tinyos.h"
+#include "kernel_sched.h"
+#include "kernel_streams.h"
+#include "kernel_pipe.h"
+#include "kernel_dev.h"
+#include "kernel_cc.h"
+
+/*
+  A timer stream is a kernel timer of the scheduler, whose function runs
+  in the ALARM interrupt handler. It counts the expirations, arms the
+  timer again for the next period, and notifies the readers and the
+  pollers. No thread sleeps for a timer, and the expirations of a period
+  that was missed are counted, not lost.
+
+  Since the count is changed by the interrupt handler, it is protected by
+  a spinlock, and readers wait for the expired flag with stream_wait_event.
+*/
+
+/*Timer Control Block*/
+typedef struct timer_control_block
+{
+	sched_timer timer;        //the kernel timer
+	TimerDuration next;       //the time of the next expiration
+	TimerDuration period;     //the time between expirations, or 0
+	uint64_t expirations;     //the expirations since the last read
+	volatile sig_atomic_t expired;   //the expirations are not 0
+	Mutex spinlock;           //protects the expirations and the poll list
+	FCB* fcb;                 //the stream, for its flags
+	CondVar expired_cv;       //readers sleep here
+	rlnode pollers;           //the poll list
+}TIMERCB;
+
+
+/*The function of the kernel timer, called from the ALARM handler*/
+static void timer_expire(sched_timer* t)
+{
+	TIMERCB* tm = (TIMERCB*)t->data;
+	uint64_t count = 1;
+
+	if (tm->period > 0){
+		/*Skip the periods that were missed, counting them*/
+		TimerDuration next = tm->next + tm->period;
+		TimerDuration now = bios_clock();
+		if (next <= now){
+			TimerDuration missed = (now - next) / tm->period + 1;
+			count += missed;
+			next += missed * tm->period;
+		}
+		tm->next = next;
+		sched_timer_arm(t, next);
+	}
+
+	Mutex_Lock(& tm->spinlock);
+	int was_zero = (tm->expirations == 0);
+	tm->expirations += count;
+	tm->expired = 1;
+	if (was_zero)
+		poll_notify(& tm->pollers);
+	Mutex_Unlock(& tm->spinlock);
+
+	Cond_Broadcast(& tm->expired_cv);
+}
+
+/*Take the expirations, resetting them to 0. Returns the old value*/
+static uint64_t timer_take(TIMERCB* tm)
+{
+	int pre = preempt_off;
+	Mutex_Lock(& tm->spinlock);
+	uint64_t value = tm->expirations;
+	tm->expirations = 0;
+	tm->expired = 0;
+	Mutex_Unlock(& tm->spinlock);
+	if (pre) preempt_on;
+	return value;
+}
+
+/*Arm the timer, or disarm it if initial is 0, and reset the expirations*/
+static void timer_arm(TIMERCB* tm, unsigned long initial, unsigned long period)
+{
+	/*After this, the handler does not use the timer*/
+	sched_timer_cancel(& tm->timer);
+	timer_take(tm);
+
+	tm->period = period;
+	if (initial > 0){
+		tm->next = bios_clock() + initial;
+		sched_timer_arm(& tm->timer, tm->next);
+	}
+}
+
+
+/*Return the expirations, waiting for one.
+Returns 8 on success, otherwise -1*/
+static int timer_read(void* this, char* buf, unsigned int size)
+{
+	TIMERCB* tm = (TIMERCB*)this;
+
+	if (size < sizeof(uint64_t))
+		return -1;
+
+	while (! tm->expired){
+		if (FCB_nonblock(tm->fcb))
+			return WOULD_BLOCK;
+		stream_wait_event(& tm->expired_cv, & tm->expired, NO_TIMEOUT);
+	}
+
+	uint64_t value = timer_take(tm);
+	memcpy(buf, &value, sizeof(value));
+	return sizeof(uint64_t);
+}
+
+/*Return the events of the timer*/
+static int timer_poll(void* this, poll_hook* hook)
+{
+	TIMERCB* tm = (TIMERCB*)this;
+
+	if (hook != NULL)
+		poll_hook_attach(hook, & tm->pollers, & tm->spinlock);
+	return tm->expired ? POLL_READ : 0;
+}
+
+/*Destroy the timer*/
+static int timer_close(void* this)
+{
+	TIMERCB* tm = (TIMERCB*)this;
+	sched_timer_cancel(& tm->timer);
+	poll_list_clear(& tm->pollers);
+	free(tm);
+	return 0;
+}
+
+/* The file operations of a timer */
+static file_ops timerOps = {
+	.Open = NULL,
+	.Read = timer_read,
+	.Write = NULL,
+	.Close = timer_close,
+	.Poll = timer_poll
+};
+
+
+void sys_Sleep(unsigned long usec)
+{
+	/*No one signals this condition, the thread wakes up at the timeout*/
+	CondVar cv = COND_INIT;
+	TimerDuration deadline = bios_clock() + usec;
+	TimerDuration now;
+
+	while ((now = bios_clock()) < deadline)
+		kernel_timedwait(&cv, SCHED_USER, deadline - now);
+}
+
+
+Fid_t sys_Timer(unsigned long initial, unsigned long period)
+{
+	TIMERCB* tm = (TIMERCB*)malloc(sizeof(TIMERCB));
+	if (tm == NULL)
+		return NOFILE;
+
+	Fid_t fid;
+	FCB* fcb;
+	if (FCB_reserve(1, &fid, &fcb) == 0){
+		free(tm);
+		return NOFILE;
+	}
+
+	sched_timer_init(& tm->timer, timer_expire, tm);
+	tm->next = NO_TIMEOUT;
+	tm->period = 0;
+	tm->expirations = 0;
+	tm->expired = 0;
+	tm->spinlock = MUTEX_INIT;
+	tm->fcb = fcb;
+	tm->expired_cv = COND_INIT;
+	rlnode_init(& tm->pollers, NULL);
+
+	fcb->streamobj = tm;
+	fcb->streamfunc = &timerOps;
+	fcb->streamtype = STREAM_TIMER;
+
+	timer_arm(tm, initial, period);
+	return fid;
+}
+
+
+int sys_TimerSet(Fid_t fd, unsigned long initial, unsigned long period)
+{
+	FCB* fcb = get_fcb(fd);
+	if (fcb == NULL || fcb->streamfunc != &timerOps)
+		return -1;
+
+	timer_arm((TIMERCB*)fcb->streamobj, initial, period);
+	return 0;
+}
@@ -177,12 +177,12 @@ int SymposiumOfProcesses(int argl, void* args)
   SymposiumTable_init(&S, symp);
   
   /* Execute philosophers */
+  philosopher_args Args[N];
   for(int i=0;i<N;i++) {
-    philosopher_args Args;
-    Args.i = i;
-    Args.S = &S;
-    Exec(PhilosopherProcess, sizeof(Args), &Args);
+    Args[i].i = i;
+    Args[i].S = &S;
   }  
+  ExecMany(PhilosopherProcess, N, sizeof(philosopher_args), Args, NULL);
 
   /* Wait for philosophers to exit */  
   for(int i=0;i<N;i++) {
@@ -46,8 +46,10 @@ typedef unsigned long timeout_t;
 typedef int Fid_t;  
 
 /** @brief The maximum number of open files per process. 
-   Only values 0 to MAX_FILEID-1 are legal for file descriptors. */
-#define MAX_FILEID 16
+   Only values 0 to MAX_FILEID-1 are legal for file descriptors. 
+   The file id table of a process grows on demand up to this limit,
+   which must be a multiple of 64. */
+#define MAX_FILEID 4096
 
 /** @brief The invalid file id. */
 #define NOFILE  (-1)
@@ -241,6 +243,33 @@ typedef int (*Task)(int, void*);
 Pid_t Exec(Task task, int argl, void* args);
 
 
+/** @brief Create many processes running the same task.
+
+  This call creates @c n new processes, all executing @c task, in a
+  single system call. The argument array @c args is split into @c n
+  consecutive slices of @c argl bytes each; the i-th process receives
+  a copy of the i-th slice, exactly as if it had been created by
+  `Exec(task, argl, args + i*argl)`. If @c args is NULL, every process
+  receives a NULL argument of length @c argl.
+
+  The main threads of all the new processes are made ready together,
+  after all the processes have been created.
+
+  @param task the main function of the new processes
+  @param n the number of processes to create
+  @param argl the length of the argument slice of each process
+  @param args the byte array of the @c n argument slices, or NULL
+  @param pids if not NULL, an array of size at least @c n, where the
+     pids of the new processes are stored
+  @return On success, the number of processes created is returned. This
+    may be less than @c n, if the maximum number of processes is reached.
+    On error, -1 is returned. Possible errors:
+    - @c task is NULL.
+  @see Exec
+  */
+int ExecMany(Task task, unsigned int n, int argl, void* args, Pid_t* pids);
+
+
 /** @brief Exit the current process.
 
   When this function is called by a process thread, the process terminates
@@ -279,6 +308,29 @@ void Exit(int val);
 */
 Pid_t WaitChild(Pid_t pid, int* exitval);
 
+/** @brief Wait on many terminating children.
+
+   This function reaps up to @c n exited child processes in a single call.
+   If no child has exited yet, it waits until some child exits or
+   the timeout expires, whichever happens first. 
+
+   The pids of the reaped children are stored in array @c pids, and,
+   if @c statuses is not NULL, their exit statuses are stored in the
+   corresponding positions of array @c statuses.
+
+   @param pids an array of size at least @c n, to hold the pids of the reaped children
+   @param statuses an array of size at least @c n for the exit statuses, or NULL
+   @param n the maximum number of children to reap
+   @param timeout the time in milliseconds to wait for some child to exit. A timeout of 0
+          does not block. A timeout of `(timeout_t)-1` means infinite timeout.
+   @return On success, the number of children reaped is returned. This is 0 if the
+   timeout expired before any child exited. On error, -1 is returned. Possible errors are:
+   - @c pids is NULL or @c n is 0.
+   - the process has no child processes to wait on.
+   @see WaitChild
+*/
+int WaitChildren(Pid_t* pids, int* statuses, unsigned int n, timeout_t timeout);
+
 /** @brief Return the PID of the caller.
 
  This function returns the pid of the current process 
@@ -369,12 +421,133 @@ int ThreadJoin(Tid_t tid, int* exitval);
   */
 int ThreadDetach(Tid_t tid);
 
+/**
+  @brief Join any one of the given threads.
+
+  This function waits until one of the threads in `tids[0..n-1]` 
+  has exited, and joins it as in @ref ThreadJoin. If several of the 
+  threads have exited, the first one in the array is joined. The
+  other threads are not affected.
+
+  @param tids an array of thread ids
+  @param n the length of the array
+  @param exitval a location where to store the exit value of the joined 
+              thread. If NULL, the exit status is not returned.
+  @returns the tid of the joined thread, or NOTHREAD on error. Possible errors are:
+    - @c tids is NULL or @c n is 0.
+    - some tid is not a thread of this process, or it is the current thread, or a detached thread.
+    - the kernel is out of memory.
+  @see ThreadJoin
+  */
+Tid_t ThreadJoinAny(const Tid_t* tids, unsigned int n, int* exitval);
+
+/**
+  @brief The completion record of a thread.
+
+  A future is filled in by the kernel when the thread created by 
+  @ref CreateThreadFuture exits.
+  */
+typedef struct future_t {
+  volatile int done;    /**< Set to 1 when the thread has exited */
+  int exitval;          /**< The exit value of the thread, valid after @c done is set */
+} future_t;
+
+/**
+  @brief Create a new thread whose completion is reported to a future.
+
+  This is like @ref CreateThread, but the new thread is detached, 
+  and when it exits (by @ref ThreadExit or by returning from @c task), 
+  its exit value is stored in @c future and `future->done` is set.
+  The future must remain valid until then.
+
+  @param future the future of the new thread
+  @returns the tid of the new thread, or NOTHREAD on error.
+  @see WaitAny
+  */
+Tid_t CreateThreadFuture(Task task, int argl, void* args, future_t* future);
+
+/**
+  @brief Wait for any one of the given futures to complete.
+
+  @param futures an array of futures of threads of this process
+  @param n the length of the array
+  @param timeout the time in milliseconds to wait. A timeout of 0 does not block. 
+         A timeout of `(timeout_t)-1` means infinite timeout.
+  @returns the index in @c futures of the first completed future, 
+     or -1 if the timeout expired or @c futures is NULL or @c n is 0.
+  */
+int WaitAny(future_t** futures, unsigned int n, timeout_t timeout);
+
 /**
   @brief Terminate the current thread.
+
+  Before the thread terminates, the destructors of its thread-local
+  storage values are called (see @ref TLSKeyCreate).
   */
 void ThreadExit(int exitval);
 
 
+/** @brief The maximum number of thread-local storage keys of a process. */
+#define MAX_TLS_KEYS 64
+
+/** @brief A thread-local storage key. */
+typedef unsigned int tls_key_t;
+
+/** @brief A destructor for thread-local storage values. */
+typedef void (*tls_destructor)(void*);
+
+/**
+  @brief Create a thread-local storage key.
+
+  The new key is valid for all threads of the current process. 
+  Every thread has its own value for the key, initially NULL.
+
+  When a thread terminates by @ref ThreadExit (or by returning from
+  its task), for each key with a non-NULL value and a non-NULL 
+  destructor, the value is set to NULL and the destructor is called
+  with the old value. If destructors set new values, this is repeated
+  a few times.
+
+  @param key the location to store the new key
+  @param dtor the destructor for the values of the key, or NULL
+  @returns 0 on success and -1 on error. Possible errors are:
+    - the process already has @c MAX_TLS_KEYS keys
+    - we are out of memory
+  */
+int TLSKeyCreate(tls_key_t* key, tls_destructor dtor);
+
+/**
+  @brief Delete a thread-local storage key.
+
+  The values of the key are cleared in all threads, without calling 
+  the destructor. The key may be returned by a later call to 
+  @ref TLSKeyCreate, with no values set.
+
+  @returns 0 on success and -1 if @c key is not a valid key.
+  */
+int TLSKeyDelete(tls_key_t key);
+
+/**
+  @brief Return the value of a thread-local storage key for the current thread.
+
+  This call does not enter the kernel.
+
+  @returns the value of the key, or NULL if the key is not valid
+     or it has no value.
+  */
+void* TLSGet(tls_key_t key);
+
+/**
+  @brief Set the value of a thread-local storage key for the current thread.
+
+  This call does not enter the kernel.
+
+  @returns 0 on success and -1 if @c key is not a valid key, or 
+     we are out of memory.
+  */
+int TLSSet(tls_key_t key, void* value);
+
+
 
 /*******************************************
  *
@@ -435,6 +608,84 @@ Fid_t OpenNull();
 int Read(Fid_t fd, char *buf, unsigned int size);
 
 
+/** 
+  @brief Set the low-water mark of a pipe or socket.
+
+  A @c Read on the stream returns as soon as the data available is at 
+  least the low-water mark (or @c size, if it is smaller), or at end of 
+  file. The default low-water mark is 1, so that @c Read returns as soon 
+  as any data is available.
+
+  For a pipe, the mark is set on the read end. For a socket, it applies
+  to the data received by this socket.
+
+  @param fd  the file ID of the stream
+  @param lowat the low-water mark, in bytes
+  @return 0 on success and -1 on error. Possible errors are:
+         - The file descriptor is invalid.
+         - The stream does not support low-water marks.
+         - @c lowat is 0.
+ */
+int SetLowWater(Fid_t fd, unsigned int lowat);
+
+
+/** 
+  @brief The result of an operation on a non-blocking stream, that would block.
+
+  @see SetNonBlock
+  */
+#define WOULD_BLOCK (-2)
+
+/** 
+  @brief Set or clear the non-blocking mode of a stream.
+
+  In non-blocking mode, an operation that would wait returns 
+  @c WOULD_BLOCK instead:
+  - @c Read, @c ReadV and @c Splice, when no data is available on a pipe, 
+    socket, message queue or terminal (see @c SetLowWater).
+  - @c Write, @c WriteV and @c Splice, when a pipe, socket or message queue 
+    is full. A write that finds some room returns the bytes that fit.
+  - @c Accept, when no connection request is pending.
+  - @c Connect. The request is queued, and the connection is made when the 
+    listener accepts it. @c Poll reports @c POLL_WRITE on the socket then, 
+    or @c POLL_HANGUP if the listener was closed.
+
+  The mode belongs to the stream, so it is shared by all the file ids 
+  made with @c Dup2 or inherited from it. To make a single call in 
+  non-blocking mode, use @c ReadNonBlock or @c WriteNonBlock.
+
+  @param fd  the file ID of the stream
+  @param nonblock 1 to set the non-blocking mode, 0 to clear it
+  @return 0 on success and -1 on error. Possible errors are:
+         - The file descriptor is invalid.
+ */
+int SetNonBlock(Fid_t fd, int nonblock);
+
+/**
+  @brief Read from a stream, as if it were in non-blocking mode.
+
+  This is like @c Read, except that it returns @c WOULD_BLOCK instead of
+  waiting, as described in @c SetNonBlock. The mode of the stream is not 
+  changed, so other users of the stream are not affected.
+
+  @see Read
+  @see SetNonBlock
+ */
+int ReadNonBlock(Fid_t fd, char *buf, unsigned int size);
+
+/**
+  @brief Write to a stream, as if it were in non-blocking mode.
+
+  This is like @c Write, except that it returns @c WOULD_BLOCK instead of
+  waiting, as described in @c SetNonBlock. The mode of the stream is not 
+  changed, so other users of the stream are not affected.
+
+  @see Write
+  @see SetNonBlock
+ */
+int WriteNonBlock(Fid_t fd, const char *buf, unsigned int size);
+
+
 /** @brief Write bytes to a stream.
 
    The @c buf and @c size arguments are, respectively, a buffer into which 
@@ -458,6 +709,137 @@ int Read(Fid_t fd, char *buf, unsigned int size);
 int Write(Fid_t fd, const char* buf, unsigned int size);
 
 
+/** @brief The maximum number of buffers in a call to @c ReadV or @c WriteV */
+#define MAX_IOV 64
+
+/**
+  @brief A buffer of a vectored I/O call.
+
+  @see ReadV
+  @see WriteV
+  */
+typedef struct iovec_s {
+	void* base;           /**< The start of the buffer */
+	unsigned int len;     /**< The size of the buffer */
+} iovec_t;
+
+
+/** @brief Read bytes from a stream into several buffers.
+
+   This call behaves like @c Read on a single buffer, made by joining the 
+   @c iovcnt buffers of @c iov in order. The buffers are filled one after
+   the other.
+
+   Streams that support it (pipes and sockets) fill all the buffers in one
+   transfer. For other streams, the buffers are read one by one, and the
+   call stops at the first short read.
+
+  @param fd  the file ID of the stream to read from
+  @param iov an array of @c iovcnt buffers
+  @param iovcnt the number of buffers, at most @c MAX_IOV
+  @return the number of bytes copied, 0 if we have reached EOF, or -1, indicating some error.
+        Possible errors are:
+         - The file descriptor is invalid.
+         - @c iov is NULL, or @c iovcnt is larger than @c MAX_IOV.
+         - The total size of the buffers is too large.
+         - There was a I/O runtime problem.
+ */
+int ReadV(Fid_t fd, const iovec_t* iov, unsigned int iovcnt);
+
+
+/** @brief Write bytes from several buffers to a stream.
+
+   This call behaves like @c Write on a single buffer, made by joining the 
+   @c iovcnt buffers of @c iov in order. 
+
+   Streams that support it (pipes and sockets) take all the buffers in one
+   transfer, so that a message made of a header and a body reaches the
+   reader at once. For other streams, the buffers are written one by one, 
+   and the call stops at the first short write.
+
+  @param fd  the file ID of the stream to write to
+  @param iov an array of @c iovcnt buffers
+  @param iovcnt the number of buffers, at most @c MAX_IOV
+  @return the number of bytes written, or -1 on error. 
+   Possible errors are:
+   - The file id is invalid.
+   - @c iov is NULL, or @c iovcnt is larger than @c MAX_IOV.
+   - The total size of the buffers is too large.
+   - There was a I/O runtime problem.
+ */
+int WriteV(Fid_t fd, const iovec_t* iov, unsigned int iovcnt);
+
+
+/**
+  @brief The events of a stream, reported by @c Poll.
+  */
+typedef enum {
+	POLL_READ = 1,     /**< @brief A @c Read would not block */
+	POLL_WRITE = 2,    /**< @brief A @c Write would not block */
+	POLL_HANGUP = 4,   /**< @brief The other end of a pipe or socket is closed */
+	POLL_INVALID = 8   /**< @brief The file id is not valid */
+} poll_events;
+
+/**
+  @brief A file id and its events, for @c Poll.
+  */
+typedef struct pollfd_s {
+	Fid_t fd;         /**< @brief The file id. It is ignored if it is @c NOFILE */
+	int events;       /**< @brief The events of interest, @c POLL_READ and/or @c POLL_WRITE */
+	int revents;      /**< @brief The events that occurred, set by @c Poll */
+} pollfd_t;
+
+
+/** @brief Wait for any of several streams to become ready.
+
+   This call examines the @c nfds file ids of @c fds and sets the 
+   @c revents field of each to the events of interest that have occurred.
+   @c POLL_HANGUP and @c POLL_INVALID are always reported. If no file id has
+   any event, the call waits until one has, or the timeout expires.
+
+   Streams that are not pipes, sockets, message queues or terminals 
+   are always ready for reading and writing.
+
+   @param fds an array of @c nfds file ids and events
+   @param nfds the number of elements of @c fds, at most @c MAX_FILEID
+   @param timeout the time in milliseconds to wait. A timeout of 0 does not block. 
+         A timeout of `(timeout_t)-1` means infinite timeout.
+   @return the number of file ids with some event, 0 if the timeout expired,
+   or -1 on error. Possible errors are:
+   - @c fds is NULL, or @c nfds is larger than @c MAX_FILEID.
+ */
+int Poll(pollfd_t* fds, unsigned int nfds, timeout_t timeout);
+
+
+/** @brief Move data from one stream to another, inside the kernel.
+
+   This call reads up to @c len bytes from @c fd_in and writes them
+   to @c fd_out, without copying them to a user buffer. Like @c Read,
+   it waits until some data is available, and it may move fewer bytes 
+   than @c len. Normally, all the bytes read are written to @c fd_out.
+
+   When both streams are pipes or connected sockets, the data is copied
+   directly from one pipe buffer to the other. For other streams, the
+   data passes through a kernel buffer. If writing to @c fd_out fails 
+   after some of the buffer was written, the number of bytes written is 
+   returned, and the rest of the bytes read from @c fd_in are lost.
+   Streams that keep message boundaries (message queues, event sets, 
+   event counters and timers) cannot be spliced.
+
+  @param fd_in  the file ID of the stream to read from
+  @param fd_out  the file ID of the stream to write to
+  @param len the maximum number of bytes to move
+  @return the number of bytes moved, 0 if @c fd_in has reached EOF, 
+   or -1 on error. Possible errors are:
+   - A file id is invalid.
+   - @c fd_in cannot be read, or @c fd_out cannot be written.
+   - A stream keeps message boundaries.
+   - The reader of @c fd_out has gone away.
+   - There was a I/O runtime problem.
+ */
+int Splice(Fid_t fd_in, Fid_t fd_out, unsigned int len);
+
+
 /** @brief Close a file id.
    
 
@@ -515,9 +897,10 @@ typedef struct pipe_s {
 	@brief Construct and return a pipe.
 
 	A pipe is a one-directional buffer accessed via two file ids,
-	one for each end of the buffer. The size of the buffer is 
-	implementation-specific, but can be assumed to be between 4 and 16 
-	kbytes. 
+	one for each end of the buffer. The capacity of the buffer is 
+	implementation-specific, but can be assumed to be at least 16 kbytes,
+	and it can be changed by @c SetPipeSize. Memory is only used for
+	the data currently in the buffer.
 
 	Once a pipe is constructed, it remains operational as long as both
 	ends are open. If the read end is closed, the write end becomes 
@@ -531,6 +914,27 @@ typedef struct pipe_s {
 */
 int Pipe(pipe_t* pipe);
 
+
+/**
+	@brief Set the capacity of a pipe.
+
+	The capacity of the buffer of the pipe accessed by @c fd is set to 
+	@c size bytes, rounded up to an implementation-specific chunk size.
+	Either end of the pipe can be given. For a connected socket, the 
+	capacity of its receiving buffer is set.
+
+	If the new capacity is less than the data already in the buffer, no
+	data is lost, but writers block until the data drops below the new 
+	capacity.
+
+	@param fd the file id of a pipe or connected socket
+	@param size the new capacity of the buffer
+	@returns the new capacity, or -1 on error. Possible reasons for error:
+		- @c fd is not a valid file id of a pipe or connected socket.
+		- @c size is 0, or larger than the maximum capacity of a pipe.
+*/
+int SetPipeSize(Fid_t fd, unsigned int size);
+
 /*******************************************
  *
  * Sockets (local)
@@ -695,6 +1099,266 @@ int ShutDown(Fid_t sock, shutdown_mode how);
 
 
 
+/*******************************************
+ *
+ * Message queues
+ *
+ *******************************************/
+
+/** @brief The number of message priorities. Priorities range from 0 to @c MSGQ_PRIORITIES-1 */
+#define MSGQ_PRIORITIES 32
+
+/** @brief The maximum size of a message */
+#define MSGQ_MAX_MSGSIZE (64*1024)
+
+/**
+	@brief Create a message queue.
+
+	A message queue is a stream that keeps the boundaries of the 
+	messages written to it. Each message is sent and received whole, 
+	with a single call. Messages are received in order of decreasing
+	priority, and in the order they were sent within a priority.
+
+	The queue is accessed through the returned file id, which can be 
+	shared by threads, copied with @c Dup2 and inherited by child 
+	processes. The queue is destroyed when its last file id is closed.
+
+	Besides @c MsgSend and @c MsgReceive, @c Write on the file id sends
+	a message of priority 0, and @c Read receives a message, returning 
+	its size. A @c Write of size 0 sends nothing and returns 0. A message 
+	of size 0 can be sent with @c MsgSend, but then @c Read cannot tell 
+	it from end of file.
+
+	@param maxmsg the maximum number of messages in the queue
+	@param msgsize the maximum size of a message, at most @c MSGQ_MAX_MSGSIZE
+	@returns a file id for the queue, or @c NOFILE on error. Possible 
+		reasons for error:
+		- @c maxmsg or @c msgsize is 0, or @c msgsize is too large.
+		- the available file ids for the process are exhausted.
+*/
+Fid_t MsgQueue(unsigned int maxmsg, unsigned int msgsize);
+
+/**
+	@brief Send a message to a message queue.
+
+	The message is copied into the queue. If the queue is full, 
+	the call blocks until a message is received.
+
+	@param fd the file id of the queue
+	@param msg the message
+	@param len the size of the message
+	@param prio the priority of the message, less than @c MSGQ_PRIORITIES
+	@returns 0 on success, or -1 on error. Possible reasons for error:
+		- @c fd is not the file id of a message queue.
+		- @c len is larger than the message size of the queue.
+		- @c prio is not a valid priority.
+*/
+int MsgSend(Fid_t fd, const void* msg, unsigned int len, unsigned int prio);
+
+/**
+	@brief Receive a message from a message queue.
+
+	The oldest message of the highest priority is removed from the queue
+	and copied to @c buf. If the queue is empty, the call blocks until a 
+	message is sent.
+
+	@param fd the file id of the queue
+	@param buf the buffer for the message
+	@param size the size of @c buf
+	@param prio if not NULL, the priority of the message is stored here
+	@returns the size of the message, or -1 on error. Possible reasons for error:
+		- @c fd is not the file id of a message queue.
+		- @c size is less than the size of the message. The message stays
+		  in the queue.
+*/
+int MsgReceive(Fid_t fd, void* buf, unsigned int size, unsigned int* prio);
+
+
+/*******************************************
+ *
+ * Event sets
+ *
+ *******************************************/
+
+/**
+  @brief The operations of @c EventCtl.
+  */
+typedef enum {
+	EVENT_ADD,    /**< @brief Register a file id with the event set */
+	EVENT_MOD,    /**< @brief Change the events of interest of a registered file id */
+	EVENT_DEL     /**< @brief Remove a file id from the event set */
+} event_op;
+
+/**
+  @brief An event reported by @c EventWait.
+  */
+typedef struct event_s {
+	Fid_t fd;         /**< @brief The file id, as it was registered */
+	int events;       /**< @brief The events that occurred, a mask of @c poll_events */
+} event_t;
+
+/**
+	@brief Create an event set.
+
+	An event set keeps a set of registered streams, with their events 
+	of interest, and a list of the streams that became ready. Unlike 
+	@c Poll, the registrations persist across calls to @c EventWait, 
+	and the cost of a wait depends on the number of ready streams, not
+	the number of registered ones.
+
+	Events are edge-triggered: a stream is reported once after its 
+	state changes, and again only after it changes again. So a reader
+	should read until the stream would block before waiting again.
+
+	The event set is destroyed when its last file id is closed.
+
+	@returns a file id for the event set, or @c NOFILE on error. Possible 
+		reasons for error:
+		- the available file ids for the process are exhausted.
+*/
+Fid_t EventSet();
+
+/**
+	@brief Change the registrations of an event set.
+
+	A stream stays registered until it is removed with @c EVENT_DEL, 
+	the event set is destroyed, or the stream itself is closed by its
+	last file id. The event set does not keep the stream open, so e.g.
+	closing the registered write end of a pipe still delivers the end 
+	of data to the reader. A stream that is ready
+	when it is added or modified is reported by the next @c EventWait.
+
+	@param evset the file id of the event set
+	@param op the operation
+	@param fd the file id of a pipe, socket, message queue or terminal
+	@param events the events of interest, @c POLL_READ and/or @c POLL_WRITE. 
+		@c POLL_HANGUP is always reported. Ignored by @c EVENT_DEL.
+	@returns 0 on success, or -1 on error. Possible reasons for error:
+		- @c evset is not the file id of an event set.
+		- @c fd is not valid, or its stream cannot be polled.
+		- @c op is @c EVENT_ADD and the stream is already registered,
+		  or @c op is @c EVENT_MOD or @c EVENT_DEL and it is not.
+*/
+int EventCtl(Fid_t evset, event_op op, Fid_t fd, int events);
+
+/**
+	@brief Wait for events in an event set.
+
+	The call returns the ready streams, at most @c maxevents of them. 
+	If none is ready, it waits until one is, or the timeout expires.
+
+	@param evset the file id of the event set
+	@param events the array where the events are stored
+	@param maxevents the size of @c events, at least 1
+	@param timeout the time in milliseconds to wait. A timeout of 0 does not block. 
+		A timeout of `(timeout_t)-1` means infinite timeout.
+	@returns the number of events stored, 0 if the timeout expired, or -1 on 
+		error. Possible reasons for error:
+		- @c evset is not the file id of an event set.
+		- @c events is NULL or @c maxevents is 0.
+*/
+int EventWait(Fid_t evset, event_t* events, unsigned int maxevents, timeout_t timeout);
+
+
+/*******************************************
+ *
+ * Event counters
+ *
+ *******************************************/
+
+/** @brief A flag of @c EventFd: each @c Read takes 1 from the counter, like a semaphore */
+#define EVENTFD_SEMAPHORE 1
+
+/**
+	@brief Create an event counter.
+
+	An event counter is a stream that holds a 64-bit unsigned counter,
+	for cheap notifications between threads and processes. It can be 
+	waited for with @c Poll and event sets, like any other stream.
+
+	- A @c Write of an 8-byte value adds it to the counter. If the counter
+	  would exceed 0xfffffffffffffffe, the call blocks until a @c Read.
+	- A @c Read of 8 bytes returns the counter and resets it to 0, or, 
+	  with @c EVENTFD_SEMAPHORE, returns 1 and decrements it. If the counter 
+	  is 0, the call blocks until a @c Write.
+
+	Both return 8 on success, and -1 if the buffer is smaller than 8 bytes
+	or, for @c Write, if the value is 0xffffffffffffffff. A @c Write of 
+	size 0 does nothing and returns 0.
+	The counter is destroyed when its last file id is closed.
+
+	@param initval the initial value of the counter
+	@param flags 0, or @c EVENTFD_SEMAPHORE
+	@returns a file id for the counter, or @c NOFILE on error. Possible 
+		reasons for error:
+		- @c flags is not valid.
+		- the available file ids for the process are exhausted.
+*/
+Fid_t EventFd(unsigned int initval, int flags);
+
+
+/*******************************************
+ *
+ * Timers
+ *
+ *******************************************/
+
+/**
+	@brief Put the calling thread to sleep.
+
+	The thread sleeps for at least @c usec microseconds. The core alarm 
+	is set for the earliest wakeup, so the call is not bound to the 
+	scheduler quantum or to the millisecond resolution of 
+	@c Cond_TimedWait.
+
+	@param usec the time to sleep, in microseconds
+*/
+void Sleep(unsigned long usec);
+
+/**
+	@brief Create a timer.
+
+	A timer is a stream that counts its expirations. It first expires 
+	@c initial microseconds after the call, and then every @c period 
+	microseconds, or only once if @c period is 0. A timer with 
+	@c initial equal to 0 is not armed.
+
+	A @c Read of 8 bytes returns the number of expirations since the 
+	last @c Read, as a 64-bit unsigned value, and resets it to 0. If 
+	there was no expiration, the call blocks until the next one. It 
+	returns 8 on success, and -1 if the buffer is smaller than 8 bytes.
+	A timer cannot be written to.
+
+	A timer can be waited for with @c Poll and event sets, like any 
+	other stream, so that periodic work does not need a thread of its 
+	own. Expirations are counted by the kernel, with no thread waiting.
+	The timer is destroyed when its last file id is closed.
+
+	@param initial the time of the first expiration, in microseconds, or 0
+	@param period the time between expirations, in microseconds, or 0
+	@returns a file id for the timer, or @c NOFILE on error. Possible 
+		reasons for error:
+		- the available file ids for the process are exhausted.
+	@see TimerSet
+*/
+Fid_t Timer(unsigned long initial, unsigned long period);
+
+/**
+	@brief Arm or disarm a timer.
+
+	The timer is armed again, as if it had just been created with 
+	@c Timer, and its count of expirations is reset to 0. 
+	With @c initial equal to 0, the timer is disarmed.
+
+	@param fd the file id of the timer
+	@param initial the time of the first expiration, in microseconds, or 0
+	@param period the time between expirations, in microseconds, or 0
+	@returns 0 on success, or -1 if @c fd is not the file id of a timer.
+*/
+int TimerSet(Fid_t fd, unsigned long initial, unsigned long period);
+
+
+
 /*******************************************
  *
  * System information
@@ -739,23 +1403,14 @@ typedef struct procinfo
     bytes contained in this field are just the prefix.  */
 } procinfo;
 
-/**
-  @brief A control block so store information for every process
-  and show it to the user
-*/
-
-typedef struct System_Information_Control_Block{ 
-  procinfo info_list[MAX_PROC];  //store the information
-  int elements;                  //the number of useful infocb in the previous array
-  int pointer;                   //it indicate the next element to return to the user.
-}SICB;
-
 /**
 	@brief Open a kernel information stream.
 
 	This is a read-only stream that returns a sequence of 
 	@c procinfo structures,
 	each packed into a block of size @c sizeof(procinfo).
+	A single @c Read returns as many whole records as fit in the
+	buffer, and 0 when the stream is exhausted.
 
 	Each procinfo structure contains information pertaining to some
 	used PCB (active or zombie) during the time of the stream. 
@@ -771,6 +1426,72 @@ typedef struct System_Information_Control_Block{
 Fid_t OpenInfo();
 
 
+/**
+  @brief The types of streams, used to break down I/O statistics.
+  */
+typedef enum {
+	STREAM_NULL,       /**< @brief The null device */
+	STREAM_TERMINAL,   /**< @brief A serial terminal */
+	STREAM_PIPE,       /**< @brief A pipe */
+	STREAM_SOCKET,     /**< @brief A socket */
+	STREAM_INFO,       /**< @brief A system information stream */
+	STREAM_MSGQ,       /**< @brief A message queue */
+	STREAM_EVSET,      /**< @brief An event set */
+	STREAM_EVENTFD,    /**< @brief An event counter */
+	STREAM_TIMER,      /**< @brief A timer */
+	STREAM_TYPES       /**< @brief The number of stream types */
+} stream_type;
+
+
+/**
+  @brief Designate whose resource usage is returned by @c GetRusage.
+  */
+typedef enum {
+	RUSAGE_SELF,      /**< @brief The calling process */
+	RUSAGE_CHILDREN   /**< @brief All reaped descendants of the calling process */
+} rusage_who;
+
+
+/**
+  @brief Resource usage statistics of a process.
+
+  @see GetRusage
+  */
+typedef struct rusage_s
+{
+	unsigned long cpu_time;         /**< @brief CPU time consumed, in microseconds. */
+	unsigned long context_switches; /**< @brief Number of times a thread of the process 
+	                                     gave up its core. */
+	unsigned long syscalls;         /**< @brief Number of system calls issued. */
+
+	unsigned long bytes_read[STREAM_TYPES];    /**< @brief Bytes read, per stream type. */
+	unsigned long bytes_written[STREAM_TYPES]; /**< @brief Bytes written, per stream type. */
+
+	unsigned long block_time;       /**< @brief Time spent blocked at pipes and sockets, 
+	                                     in microseconds. */
+	unsigned int peak_threads;      /**< @brief The maximum number of threads alive at the 
+	                                     same time. For @c RUSAGE_CHILDREN, this is the 
+	                                     maximum over all children. */
+} rusage;
+
+
+/**
+	@brief Return resource usage statistics.
+
+	When @c who is @c RUSAGE_SELF, the statistics of the calling process are returned.
+	When @c who is @c RUSAGE_CHILDREN, the totals of all the children of the calling 
+	process that have been reaped by @c WaitChild are returned. These include the 
+	totals of the children's own reaped descendants.
+
+	@param who whose statistics to return
+	@param usage the location where the statistics are stored
+	@returns 0 on success, or -1 on error. Possible reasons for error are:
+		- @c usage is NULL.
+		- @c who is not a legal value.
+ */
+int GetRusage(rusage_who who, rusage* usage);
+
+
 
 
 /*******************************************
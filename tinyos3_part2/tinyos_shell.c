@@ -720,17 +720,15 @@ finish:
    the client program
 ************************/
 
-/* helper for RemoteClient */
-static void send_message(Fid_t sock, void* buf, size_t len)
+/* helper for RemoteClient: send a message made of several buffers, in one call */
+static void send_message(Fid_t sock, const iovec_t* iov, unsigned int iovcnt)
 {
-	size_t count = 0;
-	while(count<len) {
-		int rc = Write(sock, buf+count, len-count);
-		if(rc<1) break;  /* Error or End of stream */
-		count += rc;
-	}
-	if(count!=len) {
-		printf("In client: I/O error writing %zu bytes (%zu written)\n", len, count);
+	size_t len = 0;
+	for(unsigned int i=0; i<iovcnt; i++) len += iov[i].len;
+
+	int rc = WriteV(sock, iov, iovcnt);
+	if(rc<0 || (size_t)rc!=len) {
+		printf("In client: I/O error writing %zu bytes (%d written)\n", len, rc);
 		Exit(1);
 	}
 }
@@ -755,8 +753,8 @@ int RemoteClient(size_t argc, const char** argv)
 	argvpack(args, argc-1, argv+1);
 
 	/* Send message */
-	send_message(sock, &argl, sizeof(argl));
-	send_message(sock, args, argl);
+	iovec_t msg[2] = { { &argl, sizeof(argl) }, { args, argl } };
+	send_message(sock, msg, 2);
 	ShutDown(sock, SHUTDOWN_WRITE);
 
 	/* Read the server data and display */
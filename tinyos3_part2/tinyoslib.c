@@ -8,6 +8,7 @@
 #include "util.h"
 #include "tinyos.h"
 #include "tinyoslib.h"
+#include "bios.h"
 
 
 
@@ -166,3 +167,802 @@ int Execute(Program prog, size_t argc, const char** argv)
 	return Exec(exec_wrapper, argl, args);
 }
 
+
+
+
+/*
+	Thread pools
+ */
+
+struct pool_task 
+{
+	Task task;
+	int argl;
+	void* args;
+	int retval;
+	int done;				/* Set when the task has completed */
+	ThreadPool* pool;
+};
+
+/*
+	A deque of tasks, as a growable circular buffer. The owner worker
+	pushes and pops at the bottom, thieves take from the top.
+ */
+typedef struct pool_deque
+{
+	Mutex lock;
+	PoolTask* buf;
+	unsigned int cap;		/* A power of 2, or 0 */
+	unsigned int top, bottom;	/* Free-running, top <= bottom */
+} pool_deque;
+
+struct thread_pool
+{
+	unsigned int nworkers;
+	Tid_t* tids;
+	pool_deque* deques;
+	tls_key_t self_key;			/* The value of a worker is its index plus 1 */
+
+	unsigned int pending;		/* Number of queued tasks */
+	unsigned int next_deque;	/* Round robin for tasks from outside the pool */
+	int shutdown;
+
+	Mutex lock;					/* Protects sleeping on the condition variables */
+	CondVar work_cv;			/* Idle workers sleep here */
+	CondVar done_cv;			/* Threads waiting for tasks sleep here */
+	unsigned int idle;			/* Number of workers asleep on work_cv */
+	unsigned int waiters;		/* Number of threads asleep on done_cv */
+};
+
+
+static int deque_push(pool_deque* dq, PoolTask t)
+{
+	Mutex_Lock(&dq->lock);
+	if(dq->bottom - dq->top == dq->cap) {
+		unsigned int newcap = dq->cap ? 2*dq->cap : 64;
+		PoolTask* newbuf = malloc(newcap*sizeof(PoolTask));
+		if(newbuf==NULL) { Mutex_Unlock(&dq->lock); return -1; }
+		for(unsigned int i=dq->top; i!=dq->bottom; i++)
+			newbuf[i & (newcap-1)] = dq->buf[i & (dq->cap-1)];
+		free(dq->buf);
+		dq->buf = newbuf;
+		dq->cap = newcap;
+	}
+	dq->buf[(dq->bottom++) & (dq->cap-1)] = t;
+	Mutex_Unlock(&dq->lock);
+	return 0;
+}
+
+static PoolTask deque_pop(pool_deque* dq)
+{
+	PoolTask t = NULL;
+	Mutex_Lock(&dq->lock);
+	if(dq->bottom != dq->top)
+		t = dq->buf[(--dq->bottom) & (dq->cap-1)];
+	Mutex_Unlock(&dq->lock);
+	return t;
+}
+
+static PoolTask deque_steal(pool_deque* dq)
+{
+	PoolTask t = NULL;
+	/* Avoid the lock for deques that look empty */
+	if(__atomic_load_n(&dq->bottom, __ATOMIC_RELAXED) == __atomic_load_n(&dq->top, __ATOMIC_RELAXED))
+		return NULL;
+	Mutex_Lock(&dq->lock);
+	if(dq->bottom != dq->top)
+		t = dq->buf[(dq->top++) & (dq->cap-1)];
+	Mutex_Unlock(&dq->lock);
+	return t;
+}
+
+
+/* Return the index of the calling thread among the workers, or -1 */
+static int pool_self(ThreadPool* pool)
+{
+	return (int)(intptr_t)TLSGet(pool->self_key) - 1;
+}
+
+/* Take a task, first from our own deque (if we are a worker), else from any deque */
+static PoolTask pool_take(ThreadPool* pool, int self)
+{
+	PoolTask t = NULL;
+	if(self >= 0)
+		t = deque_pop(&pool->deques[self]);
+
+	unsigned int start = (self >= 0) ? self+1 : 0;
+	for(unsigned int i=0; t==NULL && i<pool->nworkers; i++)
+		t = deque_steal(&pool->deques[(start+i) % pool->nworkers]);
+
+	if(t) __atomic_sub_fetch(&pool->pending, 1, __ATOMIC_SEQ_CST);
+	return t;
+}
+
+static void pool_run(ThreadPool* pool, PoolTask t)
+{
+	t->retval = t->task(t->argl, t->args);
+	__atomic_store_n(&t->done, 1, __ATOMIC_SEQ_CST);
+
+	/* Only take the lock if someone may be sleeping */
+	if(__atomic_load_n(&pool->waiters, __ATOMIC_SEQ_CST) > 0) {
+		Mutex_Lock(&pool->lock);
+		Cond_Broadcast(&pool->done_cv);
+		Mutex_Unlock(&pool->lock);
+	}
+}
+
+static int pool_worker(int argl, void* args)
+{
+	ThreadPool* pool = args;
+	int self = argl;
+	TLSSet(pool->self_key, (void*)(intptr_t)(self+1));
+
+	while(1) {
+		PoolTask t = pool_take(pool, self);
+		if(t) { pool_run(pool, t); continue; }
+
+		/* Sleep until there is work, or the pool is shut down */
+		Mutex_Lock(&pool->lock);
+		__atomic_add_fetch(&pool->idle, 1, __ATOMIC_SEQ_CST);
+		while(__atomic_load_n(&pool->pending, __ATOMIC_SEQ_CST)==0 && !pool->shutdown)
+			Cond_Wait(&pool->lock, &pool->work_cv);
+		__atomic_sub_fetch(&pool->idle, 1, __ATOMIC_SEQ_CST);
+		int shutdown = pool->shutdown;
+		Mutex_Unlock(&pool->lock);
+
+		if(shutdown && __atomic_load_n(&pool->pending, __ATOMIC_SEQ_CST)==0)
+			break;
+	}
+	return 0;
+}
+
+
+/* Shut down the pool, join its first nstarted workers and free it */
+static void pool_free(ThreadPool* pool, unsigned int nstarted)
+{
+	Mutex_Lock(&pool->lock);
+	pool->shutdown = 1;
+	Cond_Broadcast(&pool->work_cv);
+	Mutex_Unlock(&pool->lock);
+
+	for(unsigned int i=0; i<nstarted; i++)
+		ThreadJoin(pool->tids[i], NULL);
+	for(unsigned int i=0; i<pool->nworkers; i++)
+		free(pool->deques[i].buf);
+
+	TLSKeyDelete(pool->self_key);
+	free(pool->tids);
+	free(pool->deques);
+	free(pool);
+}
+
+
+ThreadPool* ThreadPool_Create(unsigned int nworkers)
+{
+	if(nworkers==0) nworkers = cpu_cores();
+
+	ThreadPool* pool = malloc(sizeof(ThreadPool));
+	if(pool==NULL) return NULL;
+
+	pool->nworkers = nworkers;
+	pool->tids = malloc(nworkers*sizeof(Tid_t));
+	pool->deques = malloc(nworkers*sizeof(pool_deque));
+	if(pool->tids==NULL || pool->deques==NULL || TLSKeyCreate(&pool->self_key, NULL)!=0) {
+		free(pool->tids);
+		free(pool->deques);
+		free(pool);
+		return NULL;
+	}
+
+	for(unsigned int i=0; i<nworkers; i++) {
+		pool->tids[i] = NOTHREAD;
+		pool->deques[i] = (pool_deque){ .lock=MUTEX_INIT, .buf=NULL, .cap=0, .top=0, .bottom=0 };
+	}
+	pool->pending = 0;
+	pool->next_deque = 0;
+	pool->shutdown = 0;
+	pool->lock = MUTEX_INIT;
+	pool->work_cv = COND_INIT;
+	pool->done_cv = COND_INIT;
+	pool->idle = 0;
+	pool->waiters = 0;
+
+	for(unsigned int i=0; i<nworkers; i++) {
+		Tid_t t = CreateThread(pool_worker, i, pool);
+		if(t == NOTHREAD) {
+			/* Stop the workers we have, they find no tasks */
+			pool_free(pool, i);
+			return NULL;
+		}
+		pool->tids[i] = t;
+	}
+
+	return pool;
+}
+
+
+void ThreadPool_Destroy(ThreadPool* pool)
+{
+	pool_free(pool, pool->nworkers);
+}
+
+
+PoolTask ThreadPool_Submit(ThreadPool* pool, Task task, int argl, void* args)
+{
+	PoolTask t = malloc(sizeof(struct pool_task));
+	if(t==NULL) return NULL;
+	*t = (struct pool_task){ .task=task, .argl=argl, .args=args, .retval=0, .done=0, .pool=pool };
+
+	int self = pool_self(pool);
+	unsigned int d = (self >= 0) ? self 
+		: __atomic_fetch_add(&pool->next_deque, 1, __ATOMIC_RELAXED) % pool->nworkers;
+	if(deque_push(&pool->deques[d], t) != 0) {
+		free(t);
+		return NULL;
+	}
+	__atomic_add_fetch(&pool->pending, 1, __ATOMIC_SEQ_CST);
+
+	/* Only take the lock if some worker or waiter may be sleeping. 
+	   Waiters help with the queued tasks, so they are woken up too */
+	int idle = __atomic_load_n(&pool->idle, __ATOMIC_SEQ_CST) > 0;
+	int waiters = __atomic_load_n(&pool->waiters, __ATOMIC_SEQ_CST) > 0;
+	if(idle || waiters) {
+		Mutex_Lock(&pool->lock);
+		if(idle) Cond_Signal(&pool->work_cv);
+		if(waiters) Cond_Broadcast(&pool->done_cv);
+		Mutex_Unlock(&pool->lock);
+	}
+	return t;
+}
+
+
+void ThreadPool_Wait(PoolTask task, int* retval)
+{
+	ThreadPool* pool = task->pool;
+	int self = pool_self(pool);
+
+	while(! __atomic_load_n(&task->done, __ATOMIC_SEQ_CST)) {
+		/* Help with the queued tasks */
+		PoolTask t = pool_take(pool, self);
+		if(t) { pool_run(pool, t); continue; }
+
+		/* Nothing to do, the task is running somewhere else. Sleep until
+		   some task completes or a new one is submitted */
+		Mutex_Lock(&pool->lock);
+		__atomic_add_fetch(&pool->waiters, 1, __ATOMIC_SEQ_CST);
+		if(! __atomic_load_n(&task->done, __ATOMIC_SEQ_CST) 
+			&& __atomic_load_n(&pool->pending, __ATOMIC_SEQ_CST)==0)
+			Cond_Wait(&pool->lock, &pool->done_cv);
+		__atomic_sub_fetch(&pool->waiters, 1, __ATOMIC_SEQ_CST);
+		Mutex_Unlock(&pool->lock);
+	}
+
+	if(retval) *retval = task->retval;
+	free(task);
+}
+
+
+/*
+	Parallel loops.  Each chunk is a task, whose argument is a 
+	parallel_chunk record.
+ */
+
+typedef struct parallel_chunk
+{
+	int begin, end;
+	ForBody for_body;
+	ReduceBody reduce_body;
+	void* arg;
+	long result;
+} parallel_chunk;
+
+static int parallel_chunk_task(int argl, void* args)
+{
+	parallel_chunk* c = args;
+	if(c->for_body)
+		c->for_body(c->begin, c->end, c->arg);
+	else
+		c->result = c->reduce_body(c->begin, c->end, c->arg);
+	return 0;
+}
+
+/* Split the range to chunks, run them on the pool, and combine the results */
+static long parallel_run(ThreadPool* pool, int begin, int end, int grain,
+	ForBody for_body, ReduceBody reduce_body, long identity, ReduceOp op, void* arg)
+{
+	if(end <= begin) return identity;
+
+	long n = (long)end - begin;
+	if(grain <= 0) {
+		/* A few chunks per worker, so that stealing can balance the load */
+		long g = n / (4*pool->nworkers);
+		grain = (g > 0) ? g : 1;
+	}
+	long nchunks = (n + grain - 1) / grain;
+
+	parallel_chunk* chunks = malloc(nchunks * sizeof(parallel_chunk));
+	PoolTask* tasks = malloc(nchunks * sizeof(PoolTask));
+	if(chunks==NULL || tasks==NULL) {
+		/* Out of memory, run the whole range here */
+		free(tasks);
+		free(chunks);
+		parallel_chunk all = { .begin=begin, .end=end, .for_body=for_body, 
+			.reduce_body=reduce_body, .arg=arg, .result=identity };
+		parallel_chunk_task(sizeof(parallel_chunk), &all);
+		return op ? op(identity, all.result) : identity;
+	}
+
+	for(long i=0; i<nchunks; i++) {
+		int b = begin + i*grain;
+		chunks[i] = (parallel_chunk){ .begin=b, .end=(end-b > grain) ? b+grain : end,
+			.for_body=for_body, .reduce_body=reduce_body, .arg=arg, .result=identity };
+	}
+
+	/* The caller runs the first chunk itself */
+	for(long i=1; i<nchunks; i++) {
+		tasks[i] = ThreadPool_Submit(pool, parallel_chunk_task, sizeof(parallel_chunk), &chunks[i]);
+		if(tasks[i]==NULL)	/* Out of memory, run it here */
+			parallel_chunk_task(sizeof(parallel_chunk), &chunks[i]);
+	}
+	parallel_chunk_task(sizeof(parallel_chunk), &chunks[0]);
+
+	long result = identity;
+	for(long i=0; i<nchunks; i++) {
+		if(i>0 && tasks[i]) ThreadPool_Wait(tasks[i], NULL);
+		if(op) result = op(result, chunks[i].result);
+	}
+
+	free(tasks);
+	free(chunks);
+	return result;
+}
+
+
+void ParallelFor(ThreadPool* pool, int begin, int end, int grain, ForBody body, void* arg)
+{
+	parallel_run(pool, begin, end, grain, body, NULL, 0, NULL, arg);
+}
+
+
+long ParallelReduce(ThreadPool* pool, int begin, int end, int grain, 
+	long identity, ReduceBody body, ReduceOp op, void* arg)
+{
+	return parallel_run(pool, begin, end, grain, NULL, body, identity, op, arg);
+}
+
+
+
+/*
+	Fibers
+ */
+
+typedef enum { FIBER_READY, FIBER_IO, FIBER_FINISHED } fiber_state;
+
+typedef struct fiber_carrier fiber_carrier;
+
+typedef struct fiber
+{
+	rlnode node;				/* Node in a run queue, or in the parked list of its stream */
+	cpu_context_t ctx;
+	fiber_state state;			/* Why the fiber gave up its carrier */
+	fiber_carrier* carrier;
+	void* stack;
+
+	Task task;
+	int argl;
+	void* args;
+
+	/* The stream and events a FIBER_IO fiber waits for */
+	Fid_t io_fd;
+	int io_events;
+} fiber;
+
+struct fiber_carrier
+{
+	FiberScheduler* sched;
+	Tid_t tid;
+	Mutex lock;					/* Protects runq */
+	CondVar runq_cv;
+	rlnode runq;				/* The ready fibers of this carrier */
+	fiber* current;				/* The fiber running on this carrier, or NULL */
+	cpu_context_t ctx;			/* The context of the carrier loop */
+};
+
+/* The fibers parked on a file id, and the state of its registration with the event set */
+typedef struct fiber_stream
+{
+	rlnode parked;
+	int registering;			/* A thread is in EventCtl for this stream */
+	int changed;				/* The parked fibers changed since it was registered */
+} fiber_stream;
+
+struct fiber_scheduler
+{
+	unsigned int ncarriers;
+	fiber_carrier* carriers;
+	unsigned int next_carrier;
+	tls_key_t key;				/* Maps carrier threads to their fiber_carrier */
+
+	Mutex lock;					/* Protects the fields below */
+	CondVar cv;					/* Signalled when live drops to 0 */
+	unsigned int live;			/* The fibers that have not finished */
+	int shutdown;
+
+	Fid_t evset;				/* The event set of the streams with parked fibers */
+	Tid_t poller;				/* The thread that waits on evset */
+	fiber_stream* streams;		/* The parked fibers of each file id */
+};
+
+/* The number of events the poller takes at a time */
+#define FIBER_POLL_EVENTS 16
+
+
+/* 
+	A new fiber finds itself here. The carrier sets it just before 
+	switching to it, with interrupts disabled, so the core cannot change. 
+ */
+static fiber* fiber_starting[MAX_CORES];
+
+
+/* Give the carrier back. Interrupts are disabled across the switch, as in the kernel scheduler. */
+static void fiber_switch_out(fiber* f)
+{
+	cpu_disable_interrupts();
+	cpu_swap_context(&f->ctx, &f->carrier->ctx);
+	cpu_enable_interrupts();
+}
+
+static void fiber_entry()
+{
+	fiber* f = fiber_starting[cpu_core_id];
+	cpu_enable_interrupts();
+
+	f->task(f->argl, f->args);
+
+	f->state = FIBER_FINISHED;
+	fiber_switch_out(f);
+	assert(0); /* We should not be here */
+}
+
+/* Put a fiber in the run queue of its carrier */
+static void fiber_make_ready(fiber* f)
+{
+	fiber_carrier* c = f->carrier;
+	f->state = FIBER_READY;
+	Mutex_Lock(&c->lock);
+	rlist_push_back(&c->runq, &f->node);
+	Cond_Signal(&c->runq_cv);
+	Mutex_Unlock(&c->lock);
+}
+
+/* 
+	Register the events of the fibers parked on a stream with the event set,
+	or remove the stream if none is left. Called with sched->lock held, 
+	which is dropped during EventCtl. If another thread is registering the
+	stream, it is left to do it again with the new events. The fibers of a 
+	stream that cannot be registered are made ready, to retry their call 
+	and get its error.
+ */
+static void fiber_io_register(FiberScheduler* sched, Fid_t fd)
+{
+	fiber_stream* st = &sched->streams[fd];
+	st->changed = 1;
+	if(st->registering)
+		return;
+
+	st->registering = 1;
+	while(st->changed) {
+		st->changed = 0;
+
+		rlnode* list = &st->parked;
+		int events = 0;
+		for(rlnode* n = list->next; n != list; n = n->next)
+			events |= ((fiber*)n->obj)->io_events;
+
+		Mutex_Unlock(&sched->lock);
+		int rc;
+		if(events == 0)
+			rc = EventCtl(sched->evset, EVENT_DEL, fd, 0);
+		/* A stream that is already ready is reported at once */
+		else if((rc = EventCtl(sched->evset, EVENT_MOD, fd, events)) != 0)
+			rc = EventCtl(sched->evset, EVENT_ADD, fd, events);
+		Mutex_Lock(&sched->lock);
+
+		if(rc != 0 && events != 0) {
+			while(! is_rlist_empty(list))
+				fiber_make_ready(rlist_pop_front(list)->obj);
+			st->changed = 1;
+		}
+	}
+	st->registering = 0;
+}
+
+/* Make ready the fibers parked on a stream, for which it has events */
+static void fiber_io_wakeup(FiberScheduler* sched, Fid_t fd, int events)
+{
+	/* A hangup ends the wait of every fiber */
+	if(events & POLL_HANGUP)
+		events |= POLL_READ | POLL_WRITE;
+
+	rlnode* list = &sched->streams[fd].parked;
+	for(rlnode* n = list->next; n != list; ) {
+		fiber* f = n->obj;
+		n = n->next;
+		if(f->io_events & events) {
+			rlist_remove(&f->node);
+			fiber_make_ready(f);
+		}
+	}
+	fiber_io_register(sched, fd);
+}
+
+/* Wait for the streams of the parked fibers */
+static int fiber_poller(int argl, void* args)
+{
+	FiberScheduler* sched = args;
+	event_t ev[FIBER_POLL_EVENTS];
+
+	while(1) {
+		int n = EventWait(sched->evset, ev, FIBER_POLL_EVENTS, (timeout_t)-1);
+
+		Mutex_Lock(&sched->lock);
+		if(sched->shutdown) {
+			Mutex_Unlock(&sched->lock);
+			break;
+		}
+		for(int i=0; i<n; i++)
+			fiber_io_wakeup(sched, ev[i].fd, ev[i].events);
+		Mutex_Unlock(&sched->lock);
+	}
+	return 0;
+}
+
+/* Called by the carrier, after a fiber has switched out */
+static void fiber_switched_out(FiberScheduler* sched, fiber* f)
+{
+	switch(f->state) {
+	case FIBER_READY:
+		fiber_make_ready(f);
+		break;
+
+	case FIBER_IO:
+		/* The fiber is off its stack now, so the poller may resume it */
+		Mutex_Lock(&sched->lock);
+		rlist_push_back(&sched->streams[f->io_fd].parked, &f->node);
+		fiber_io_register(sched, f->io_fd);
+		Mutex_Unlock(&sched->lock);
+		break;
+
+	case FIBER_FINISHED:
+		free(f->stack);
+		free(f);
+		Mutex_Lock(&sched->lock);
+		if(--sched->live == 0)
+			Cond_Broadcast(&sched->cv);
+		Mutex_Unlock(&sched->lock);
+		break;
+	}
+}
+
+static int fiber_carrier_loop(int argl, void* args)
+{
+	FiberScheduler* sched = args;
+	fiber_carrier* c = &sched->carriers[argl];
+	TLSSet(sched->key, c);
+
+	while(1) {
+		Mutex_Lock(&c->lock);
+		while(is_rlist_empty(&c->runq) && !sched->shutdown)
+			Cond_Wait(&c->lock, &c->runq_cv);
+		if(is_rlist_empty(&c->runq)) {
+			Mutex_Unlock(&c->lock);
+			break;
+		}
+		fiber* f = rlist_pop_front(&c->runq)->obj;
+		Mutex_Unlock(&c->lock);
+
+		c->current = f;
+		cpu_disable_interrupts();
+		fiber_starting[cpu_core_id] = f;
+		cpu_swap_context(&c->ctx, &f->ctx);
+		cpu_enable_interrupts();
+		c->current = NULL;
+
+		fiber_switched_out(sched, f);
+	}
+	return 0;
+}
+
+
+/* Stop the first nstarted carriers, which find no fibers, and free the scheduler */
+static void fiber_sched_free(FiberScheduler* sched, unsigned int nstarted)
+{
+	Mutex_Lock(&sched->lock);
+	sched->shutdown = 1;
+	Mutex_Unlock(&sched->lock);
+
+	for(unsigned int i=0; i<nstarted; i++) {
+		fiber_carrier* c = &sched->carriers[i];
+		Mutex_Lock(&c->lock);
+		Cond_Broadcast(&c->runq_cv);
+		Mutex_Unlock(&c->lock);
+	}
+	for(unsigned int i=0; i<nstarted; i++)
+		ThreadJoin(sched->carriers[i].tid, NULL);
+
+	/* A carrier may still be registering a stream of its last fiber */
+	Close(sched->evset);
+	TLSKeyDelete(sched->key);
+	free(sched->streams);
+	free(sched->carriers);
+	free(sched);
+}
+
+
+FiberScheduler* FiberScheduler_Create(unsigned int ncarriers)
+{
+	if(ncarriers==0) ncarriers = cpu_cores();
+
+	FiberScheduler* sched = malloc(sizeof(FiberScheduler));
+	if(sched==NULL) return NULL;
+	sched->carriers = malloc(ncarriers*sizeof(fiber_carrier));
+	sched->streams = malloc(MAX_FILEID*sizeof(fiber_stream));
+	sched->evset = EventSet();
+	if(sched->carriers==NULL || sched->streams==NULL || sched->evset==NOFILE
+		|| TLSKeyCreate(&sched->key, NULL)!=0) {
+		if(sched->evset!=NOFILE) Close(sched->evset);
+		free(sched->streams);
+		free(sched->carriers);
+		free(sched);
+		return NULL;
+	}
+
+	sched->ncarriers = ncarriers;
+	sched->next_carrier = 0;
+	sched->lock = MUTEX_INIT;
+	sched->cv = COND_INIT;
+	sched->live = 0;
+	sched->shutdown = 0;
+	for(unsigned int fd=0; fd<MAX_FILEID; fd++) {
+		rlnode_init(&sched->streams[fd].parked, NULL);
+		sched->streams[fd].registering = 0;
+		sched->streams[fd].changed = 0;
+	}
+
+	for(unsigned int i=0; i<ncarriers; i++) {
+		fiber_carrier* c = &sched->carriers[i];
+		c->sched = sched;
+		c->lock = MUTEX_INIT;
+		c->runq_cv = COND_INIT;
+		rlnode_init(&c->runq, NULL);
+		c->current = NULL;
+	}
+	for(unsigned int i=0; i<ncarriers; i++) {
+		sched->carriers[i].tid = CreateThread(fiber_carrier_loop, i, sched);
+		if(sched->carriers[i].tid == NOTHREAD) {
+			fiber_sched_free(sched, i);
+			return NULL;
+		}
+	}
+	sched->poller = CreateThread(fiber_poller, 0, sched);
+	if(sched->poller == NOTHREAD) {
+		fiber_sched_free(sched, ncarriers);
+		return NULL;
+	}
+
+	return sched;
+}
+
+
+void FiberScheduler_Destroy(FiberScheduler* sched)
+{
+	Mutex_Lock(&sched->lock);
+	while(sched->live > 0)
+		Cond_Wait(&sched->lock, &sched->cv);
+	sched->shutdown = 1;
+	Mutex_Unlock(&sched->lock);
+
+	/* Wake up the poller with a stream that is ready */
+	Fid_t wake = EventFd(1, 0);
+	if(wake != NOFILE)
+		EventCtl(sched->evset, EVENT_ADD, wake, POLL_READ);
+	ThreadJoin(sched->poller, NULL);
+	if(wake != NOFILE)
+		Close(wake);
+
+	fiber_sched_free(sched, sched->ncarriers);
+}
+
+
+int Fiber_Spawn(FiberScheduler* sched, Task task, int argl, void* args)
+{
+	fiber* f = malloc(sizeof(fiber));
+	void* stack = malloc(FIBER_STACK_SIZE);
+	if(f==NULL || stack==NULL) {
+		free(f);
+		free(stack);
+		return -1;
+	}
+
+	rlnode_init(&f->node, f);
+	f->stack = stack;
+	f->task = task;
+	f->argl = argl;
+	f->args = args;
+
+	/* The context starts with interrupts disabled, like the carrier switching to it */
+	cpu_disable_interrupts();
+	cpu_initialize_context(&f->ctx, stack, FIBER_STACK_SIZE, fiber_entry);
+	cpu_enable_interrupts();
+
+	unsigned int i = __atomic_fetch_add(&sched->next_carrier, 1, __ATOMIC_RELAXED);
+	f->carrier = &sched->carriers[i % sched->ncarriers];
+
+	Mutex_Lock(&sched->lock);
+	sched->live++;
+	Mutex_Unlock(&sched->lock);
+
+	fiber_make_ready(f);
+	return 0;
+}
+
+
+/* Return the calling fiber, or NULL if the caller is not a fiber of sched */
+static fiber* fiber_self(FiberScheduler* sched)
+{
+	fiber_carrier* c = TLSGet(sched->key);
+	return (c==NULL) ? NULL : c->current;
+}
+
+
+void Fiber_Yield(FiberScheduler* sched)
+{
+	fiber* f = fiber_self(sched);
+	if(f==NULL) return;
+
+	f->state = FIBER_READY;
+	fiber_switch_out(f);
+}
+
+
+/* 
+	Make a non-blocking I/O call, parking the fiber on the poller of the 
+	scheduler while the call would block. The mode of the stream is not
+	changed, since other threads may use it.
+ */
+static int fiber_io(fiber* f, int write, Fid_t fd, char* buf, unsigned int size)
+{
+	while(1) {
+		int rc = write ? WriteNonBlock(fd, buf, size) : ReadNonBlock(fd, buf, size);
+		if(rc != WOULD_BLOCK)
+			return rc;
+
+		f->io_fd = fd;
+		f->io_events = write ? POLL_WRITE : POLL_READ;
+		f->state = FIBER_IO;
+		fiber_switch_out(f);
+	}
+}
+
+int Fiber_Read(FiberScheduler* sched, Fid_t fd, char* buf, unsigned int size)
+{
+	fiber* f = fiber_self(sched);
+	if(f==NULL) return Read(fd, buf, size);
+	return fiber_io(f, 0, fd, buf, size);
+}
+
+int Fiber_Write(FiberScheduler* sched, Fid_t fd, const char* buf, unsigned int size)
+{
+	fiber* f = fiber_self(sched);
+	if(f==NULL) return Write(fd, buf, size);
+
+	/* A non-blocking write may take only the bytes that fit */
+	unsigned int count = 0;
+	do {
+		int rc = fiber_io(f, 1, fd, (char*)buf+count, size-count);
+		if(rc <= 0)
+			return (count > 0) ? (int)count : rc;
+		count += rc;
+	} while(count < size);
+	return count;
+}
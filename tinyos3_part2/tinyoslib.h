@@ -73,4 +73,197 @@ int Execute(Program prog, size_t argc, const char** argv);
 int ParseProcInfo(procinfo* pinfo, Program* prog, int argc, const char** argv );
 
 
+/**
+	@brief A pool of worker threads.
+
+	A thread pool runs small tasks on a fixed set of TinyOS threads of the
+	current process, so that a task does not pay for @ref CreateThread
+	and @ref ThreadJoin. Each worker has its own deque of tasks. Tasks
+	submitted by a worker go to the bottom of its own deque, and the
+	worker takes them back from the bottom (most recent first). A worker
+	whose deque is empty steals from the top of the deque of another worker.
+
+	A thread waiting for a task (see @ref ThreadPool_Wait) runs other
+	queued tasks while it waits, so tasks may themselves submit and wait
+	for other tasks.
+
+	@see ThreadPool_Create
+  */
+typedef struct thread_pool ThreadPool;
+
+/**
+	@brief A handle to a task submitted to a thread pool.
+
+	@see ThreadPool_Submit
+	@see ThreadPool_Wait
+  */
+typedef struct pool_task* PoolTask;
+
+/**
+	@brief Create a thread pool.
+
+	The workers know themselves by a thread-local storage key of the 
+	process (see @ref TLSKeyCreate), which the pool holds until it is 
+	destroyed.
+
+	@param nworkers the number of worker threads. If it is 0, 
+	   one worker per core is created.
+	@returns the new pool, or NULL on error.
+  */
+ThreadPool* ThreadPool_Create(unsigned int nworkers);
+
+/**
+	@brief Destroy a thread pool.
+
+	All tasks submitted to the pool must have been waited for. The 
+	worker threads are stopped and joined, and the pool is freed.
+  */
+void ThreadPool_Destroy(ThreadPool* pool);
+
+/**
+	@brief Submit a task to a thread pool.
+
+	The call `task(argl, args)` will be executed by some worker of
+	the pool. The memory pointed to by @c args is not copied, so it 
+	must remain valid until the task completes.
+
+	Every submitted task must be waited for by exactly one call
+	to @ref ThreadPool_Wait.
+
+	@returns a handle to the task, or NULL on error.
+  */
+PoolTask ThreadPool_Submit(ThreadPool* pool, Task task, int argl, void* args);
+
+/**
+	@brief Wait for a submitted task to complete.
+
+	While the task has not completed, the calling thread runs other
+	tasks of the pool. The handle is released by this call.
+
+	@param task the handle returned by @ref ThreadPool_Submit
+	@param retval if not NULL, the location to store the return value of the task
+  */
+void ThreadPool_Wait(PoolTask task, int* retval);
+
+/**
+	@brief The body of a parallel loop, over the index range `[begin, end)`.
+  */
+typedef void (*ForBody)(int begin, int end, void* arg);
+
+/**
+	@brief Execute a loop in parallel.
+
+	The range `[begin, end)` is split in chunks of @c grain indices
+	(the last one may be smaller) and `body(b, e, arg)` is called for
+	each chunk `[b,e)` on the pool. The call returns after all chunks
+	have completed.
+
+	@param grain the chunk size. If it is 0, a chunk size is chosen
+	   so that every worker gets a few chunks.
+  */
+void ParallelFor(ThreadPool* pool, int begin, int end, int grain, ForBody body, void* arg);
+
+/**
+	@brief The body of a parallel reduction, returning the partial result for `[begin, end)`.
+  */
+typedef long (*ReduceBody)(int begin, int end, void* arg);
+
+/**
+	@brief The combining operation of a parallel reduction. It must be associative.
+  */
+typedef long (*ReduceOp)(long a, long b);
+
+/**
+	@brief Execute a reduction in parallel.
+
+	The range `[begin, end)` is split in chunks as in @ref ParallelFor.
+	The partial results of the chunks are combined in index order with
+	@c op, starting from @c identity.
+
+	@returns the combined result.
+  */
+long ParallelReduce(ThreadPool* pool, int begin, int end, int grain, 
+	long identity, ReduceBody body, ReduceOp op, void* arg);
+
+
+/**
+	@brief A scheduler of user-level fibers.
+
+	Fibers are cooperative threads with small stacks, that are multiplexed 
+	on a few TinyOS threads of the current process, the carriers. Each
+	carrier has its own run queue of fibers. A fiber runs on the same
+	carrier until it completes, and it gives the carrier to other fibers
+	only when it calls @ref Fiber_Yield, @ref Fiber_Read or @ref Fiber_Write.
+
+	The calls @ref Fiber_Read and @ref Fiber_Write use @ref ReadNonBlock
+	and @ref WriteNonBlock, without changing the mode of the stream. When 
+	the call would block, the fiber is parked and the stream is added to 
+	an event set of the scheduler, so that the carrier keeps running 
+	other fibers. A single
+	poller thread per scheduler waits on the event set and makes the
+	parked fibers ready again, however many they are.
+
+	@see FiberScheduler_Create
+  */
+typedef struct fiber_scheduler FiberScheduler;
+
+/** @brief The stack size of a fiber. */
+#define FIBER_STACK_SIZE (16*1024)
+
+/**
+	@brief Create a fiber scheduler.
+
+	@param ncarriers the number of carrier threads. If it is 0, one carrier 
+	   per core is created.
+	@returns the new scheduler, or NULL on error.
+  */
+FiberScheduler* FiberScheduler_Create(unsigned int ncarriers);
+
+/**
+	@brief Destroy a fiber scheduler.
+
+	Wait for all the fibers of the scheduler to complete, then stop 
+	the carrier and poller threads and free the scheduler. This must 
+	not be called by a fiber.
+  */
+void FiberScheduler_Destroy(FiberScheduler* sched);
+
+/**
+	@brief Create a new fiber.
+
+	The fiber executes `task(argl, args)` and its return value is
+	discarded. Fibers are assigned to the carriers round-robin. 
+	This may be called by fibers and by other threads.
+
+	@returns 0 on success and -1 if we are out of memory.
+  */
+int Fiber_Spawn(FiberScheduler* sched, Task task, int argl, void* args);
+
+/**
+	@brief Let the other fibers of the carrier run.
+
+	If the caller is not a fiber of @c sched, this call does nothing.
+  */
+void Fiber_Yield(FiberScheduler* sched);
+
+/**
+	@brief Read from a stream without blocking the carrier.
+
+	This is like @ref Read, but only the calling fiber waits for the 
+	call to complete.
+	If the caller is not a fiber of @c sched, this is the same as @ref Read.
+  */
+int Fiber_Read(FiberScheduler* sched, Fid_t fd, char* buf, unsigned int size);
+
+/**
+	@brief Write to a stream without blocking the carrier.
+
+	This is like @ref Write, but only the calling fiber waits for the 
+	call to complete, and it returns when all of @c buf is written, or on
+	error.
+	If the caller is not a fiber of @c sched, this is the same as @ref Write.
+  */
+int Fiber_Write(FiberScheduler* sched, Fid_t fd, const char* buf, unsigned int size);
+
+
 #endif
@@ -291,6 +291,7 @@ typedef struct device_control_block DCB;	/**< @brief Forward declaration */
 typedef struct file_control_block FCB;		/**< @brief Forward declaration */
 typedef struct pt_control_block PTCB;		/**< @brief Forward declaration */
 typedef struct connection_request REQUESTCB; /**< @brief Forward declaration */
+typedef struct sched_timer sched_timer;	/**< @brief Forward declaration */
 
 /** @brief A convenience typedef */
 typedef struct resource_list_node * rlnode_ptr;
@@ -318,6 +319,7 @@ typedef struct resource_list_node {
     FCB* fcb;
     PTCB* ptcb;
     REQUESTCB* request;
+    sched_timer* timer;
     void* obj;
     rlnode_ptr node;
     intptr_t num;
@@ -214,6 +214,92 @@ BOOT_TEST(test_exec_copies_arguments,
 }
 
 
+BOOT_TEST(test_execmany_passes_slices,
+	"Test that ExecMany creates many children, passing each a copy of its own argument slice."
+	)
+{
+	int child(int argl, void* args)
+	{
+		ASSERT(argl==sizeof(int));
+		int value = *(int*)args;
+		*(int*)args = -1;
+		return value;
+	}
+
+	int values[20];
+	Pid_t pids[20];
+	for(int i=0;i<20;i++) values[i] = 100+i;
+
+	ASSERT(ExecMany(NULL, 20, sizeof(int), values, pids)==-1);
+	ASSERT(ExecMany(child, 0, sizeof(int), values, pids)==0);
+	ASSERT(ExecMany(child, 20, sizeof(int), values, pids)==20);
+
+	for(int i=0;i<20;i++) {
+		int status;
+		ASSERT(WaitChild(pids[i], &status)==pids[i]);
+		ASSERT(status==100+i);
+		ASSERT(values[i]==100+i);
+	}
+	return 0;
+}
+
+
+BOOT_TEST(test_waitchildren_reaps_many,
+	"Test that WaitChildren reaps many children in one call, and that it honours its timeout."
+	)
+{
+	pipe_t pipe;
+
+	int blocked_child(int argl, void* args)
+	{
+		char c;
+		Close(pipe.write);
+		ASSERT(Read(pipe.read, &c, 1)==1);
+		return 7;
+	}
+
+	int child(int argl, void* args)
+	{
+		return *(int*)args;
+	}
+
+	Pid_t pids[20];
+	int statuses[20];
+	ASSERT(WaitChildren(pids, statuses, 20, 0)==-1);
+
+	ASSERT(Pipe(&pipe)==0);
+	Pid_t blocked = Exec(blocked_child, 0, NULL);
+	ASSERT(blocked!=NOPROC);
+	Close(pipe.read);
+
+	/* The only child is blocked, so we time out */
+	ASSERT(WaitChildren(pids, statuses, 20, 0)==0);
+	ASSERT(WaitChildren(pids, statuses, 20, 50)==0);
+
+	int values[10];
+	for(int i=0;i<10;i++) values[i] = i;
+	ASSERT(ExecMany(child, 10, sizeof(int), values, NULL)==10);
+	ASSERT(Write(pipe.write, "x", 1)==1);
+	Close(pipe.write);
+
+	int total = 0, sum = 0, rc;
+	while(total < 11) {
+		ASSERT((rc = WaitChildren(pids, statuses, 20, -1))>0);
+		for(int i=0;i<rc;i++) {
+			if(pids[i]==blocked)
+				ASSERT(statuses[i]==7);
+			else
+				ASSERT(statuses[i]>=0 && statuses[i]<10);
+			sum += statuses[i];
+		}
+		total += rc;
+	}
+	ASSERT(sum == 45+7);
+	ASSERT(WaitChildren(pids, statuses, 20, -1)==-1);
+	return 0;
+}
+
+
 BOOT_TEST(test_wait_for_any_child, 
 	"Test WaitChild when called to wait on any child."
 	)
@@ -476,6 +562,36 @@ BOOT_TEST(test_cond_timedwait_broadcast,
 }
 
 
+BOOT_TEST(test_sleep,
+	"Test that Sleep waits for at least the given time, with a resolution "
+	"finer than the scheduler quantum."
+	)
+{
+	unsigned long tspec2usec(struct timespec t)
+	{
+		return 1000000ul*t.tv_sec + t.tv_nsec/1000ul;
+	}
+
+	struct timespec t1, t2;
+	clock_gettime(CLOCK_REALTIME, &t1);
+	Sleep(200000);
+	clock_gettime(CLOCK_REALTIME, &t2);
+	unsigned long Dt = tspec2usec(t2)-tspec2usec(t1);
+	ASSERT(Dt >= 200000 && Dt < 300000);
+
+	/* 20 short sleeps take much less than 20 quanta of 10ms */
+	clock_gettime(CLOCK_REALTIME, &t1);
+	for(int i=0; i<20; i++)
+		Sleep(1000);
+	clock_gettime(CLOCK_REALTIME, &t2);
+	Dt = tspec2usec(t2)-tspec2usec(t1);
+	ASSERT_MSG(Dt >= 20000 && Dt < 100000, "20 sleeps of 1ms took %lu usec\n", Dt);
+
+	Sleep(0);
+	return 0;
+}
+
+
 
 /*********************************************
  *
@@ -543,6 +659,28 @@ BOOT_TEST(test_close_error_on_invalid_fid,
 	return 0;
 }
 
+BOOT_TEST(test_open_uses_lowest_free_fid,
+	"Test that the file id table grows past its initial size, and that new streams take the lowest free fid."
+	)
+{
+	for(Fid_t i=0; i<200; i++)
+		ASSERT(OpenNull()==i);
+
+	ASSERT(Close(150)==0);
+	ASSERT(Close(5)==0);
+	ASSERT(Close(70)==0);
+	ASSERT(OpenNull()==5);
+	ASSERT(OpenNull()==70);
+	ASSERT(OpenNull()==150);
+	ASSERT(OpenNull()==200);
+
+	ASSERT(Dup2(0, 1000)==0);
+	ASSERT(Close(1000)==0);
+	ASSERT(OpenNull()==201);
+	return 0;
+}
+
+
 BOOT_TEST(test_close_success_on_valid_nonfile_fid,
 	"Test that Close returns success on valid fid, even if there is no\n"
 	"open file for this id."
@@ -728,6 +866,41 @@ BOOT_TEST(test_child_inherits_files,
 
 
 
+BOOT_TEST(test_inherited_files_are_private,
+	"Test that changes to the inherited files of a child are not seen by the parent, and vice versa."
+	)
+{
+	pipe_t pipe;
+	ASSERT(Pipe(&pipe)==0);
+
+	int child(int argl, void* args)
+	{
+		/* The parent's table is not affected by our changes */
+		ASSERT(Close(pipe.read)==0);
+		ASSERT(Dup2(pipe.write, 10)==0);
+		ASSERT(OpenNull()==pipe.read);
+		ASSERT(Write(10, "Hello", 6)==6);
+		ASSERT(Write(pipe.write, "World", 6)==6);
+		return 0;
+	}
+
+	Pid_t cpid = Exec(child, 0, NULL);
+	ASSERT(cpid!=NOPROC);
+	ASSERT(Close(pipe.write)==0);
+	ASSERT(WaitChild(cpid, NULL)==cpid);
+
+	/* Our read end survives the close by the child */
+	char buffer[6];
+	ASSERT(Read(pipe.read, buffer, 6)==6);
+	ASSERT(strcmp(buffer, "Hello")==0);
+	ASSERT(Read(pipe.read, buffer, 6)==6);
+	ASSERT(strcmp(buffer, "World")==0);
+	ASSERT(Read(pipe.read, buffer, 6)==0);
+	ASSERT(Read(10, buffer, 6)==-1);
+	return 0;
+}
+
+
 BOOT_TEST(test_null_device,
 	"Test the null device."
 	)
@@ -876,6 +1049,8 @@ TEST_SUITE(basic_tests,
 	&test_waitchild_error_on_invalid_pid,
 	&test_exec_getpid_wait,
 	&test_exec_copies_arguments,
+	&test_execmany_passes_slices,
+	&test_waitchildren_reaps_many,
 	&test_exit_returns_status,
 	&test_main_return_returns_status,
 	&test_wait_for_any_child,
@@ -883,6 +1058,7 @@ TEST_SUITE(basic_tests,
 	&test_cond_timedwait_timeout,
 	&test_cond_timedwait_signal,
 	&test_cond_timedwait_broadcast,
+	&test_sleep,
 	&test_null_device,
 	&test_get_terminals,
 	&test_open_terminals,
@@ -891,6 +1067,7 @@ TEST_SUITE(basic_tests,
 	&test_dup2_copies_file,
 	&test_close_error_on_invalid_fid,
 	&test_close_success_on_valid_nonfile_fid,
+	&test_open_uses_lowest_free_fid,
 	&test_close_terminals,
 	&test_read_kbd,
 	&test_read_kbd_big,
@@ -901,6 +1078,7 @@ TEST_SUITE(basic_tests,
 	&test_write_error_on_bad_fid,
 	&test_write_to_many_terminals,
 	&test_child_inherits_files,
+	&test_inherited_files_are_private,
 	NULL
 };
 
@@ -970,12 +1148,429 @@ BOOT_TEST(test_exit_many_threads,
 
 
 
+BOOT_TEST(test_recycle_threads_and_processes,
+	"Test that thread and process resources are recycled correctly, when many "
+	"threads and processes are created and reaped in sequence."
+	)
+{
+	int task(int argl, void* args) {
+		return argl;
+	}
+
+	for(int i=0;i<200;i++) {
+		Tid_t t = CreateThread(task, i, NULL);
+		ASSERT(t!=NOTHREAD);
+		int exitval;
+		ASSERT(ThreadJoin(t, &exitval)==0);
+		ASSERT(exitval==i);
+		ASSERT(ThreadJoin(t, &exitval)==-1);
+	}
+
+	for(int i=0;i<200;i++) {
+		Pid_t pid = Exec(task, i, NULL);
+		ASSERT(pid!=NOPROC);
+		int status;
+		ASSERT(WaitChild(pid, &status)==pid);
+		ASSERT(status==i);
+	}
+	return 0;
+}
+
+
+/* Detached threads may outlive the test, so their task must not be a
+   nested function, whose trampoline lives on the stack of the test. */
+static int return_argl(int argl, void* args)
+{
+	return argl;
+}
+
+BOOT_TEST(test_join_detach_many_threads,
+	"Test that ThreadJoin and ThreadDetach find the right thread among many, "
+	"and that thread ids are allocated per process."
+	)
+{
+	const int N = 300;
+	Tid_t tids[N];
+
+	ASSERT(ThreadSelf()==1);
+
+	for(int i=0;i<N;i++) {
+		tids[i] = CreateThread(return_argl, i, NULL);
+		ASSERT(tids[i]!=NOTHREAD);
+	}
+
+	/* Detach every third thread, join the rest in reverse order */
+	for(int i=0;i<N;i+=3)
+		ThreadDetach(tids[i]);
+	for(int i=N-1;i>=0;i--) {
+		if(i%3==0) continue;
+		int exitval;
+		ASSERT(ThreadJoin(tids[i], &exitval)==0);
+		ASSERT(exitval==i);
+		ASSERT(ThreadJoin(tids[i], &exitval)==-1);
+	}
+	ASSERT(ThreadJoin(tids[N-1]+1000, NULL)==-1);
+
+	/* A child process numbers its threads from the start */
+	int child(int argl, void* args) {
+		ASSERT(ThreadSelf()==1);
+		Tid_t t = CreateThread(return_argl, 7, NULL);
+		ASSERT(t==2);
+		int exitval;
+		ASSERT(ThreadJoin(t, &exitval)==0);
+		ASSERT(exitval==7);
+		return 0;
+	}
+	Pid_t pid = Exec(child, 0, NULL);
+	int status;
+	ASSERT(WaitChild(pid, &status)==pid);
+	ASSERT(status==0);
+	return 0;
+}
+
+
+BOOT_TEST(test_thread_pool,
+	"Test that a thread pool runs submitted tasks, parallel loops and reductions, "
+	"including tasks that wait for other tasks, and waiters that run new tasks."
+	)
+{
+	ThreadPool* pool = ThreadPool_Create(4);
+	ASSERT(pool != NULL);
+
+	int square(int argl, void* args) {
+		return argl*argl;
+	}
+
+	PoolTask tasks[100];
+	for(int i=0;i<100;i++) {
+		tasks[i] = ThreadPool_Submit(pool, square, i, NULL);
+		ASSERT(tasks[i]!=NULL);
+	}
+	for(int i=0;i<100;i++) {
+		int retval;
+		ThreadPool_Wait(tasks[i], &retval);
+		ASSERT(retval==i*i);
+	}
+
+	const int N = 10000;
+	int A[N];
+	void fill(int begin, int end, void* arg) {
+		int* a = arg;
+		for(int i=begin;i<end;i++) a[i] = i;
+	}
+	ParallelFor(pool, 0, N, 0, fill, A);
+	for(int i=0;i<N;i++) ASSERT(A[i]==i);
+
+	long sum(int begin, int end, void* arg) {
+		int* a = arg;
+		long s = 0;
+		for(int i=begin;i<end;i++) s += a[i];
+		return s;
+	}
+	long add(long a, long b) { return a+b; }
+	ASSERT(ParallelReduce(pool, 0, N, 7, 0, sum, add, A) == (long)N*(N-1)/2);
+	ASSERT(ParallelReduce(pool, 5, 5, 0, 42, sum, add, A) == 42);
+
+	/* Tasks that run nested parallel loops on the same pool */
+	int nested(int argl, void* args) {
+		return (int) ParallelReduce(pool, 0, argl, 1, 0, sum, add, A);
+	}
+	for(int i=0;i<20;i++)
+		tasks[i] = ThreadPool_Submit(pool, nested, 100+i, NULL);
+	for(int i=0;i<20;i++) {
+		int retval;
+		ThreadPool_Wait(tasks[i], &retval);
+		ASSERT(retval == (100+i)*(99+i)/2);
+	}
+	ThreadPool_Destroy(pool);
+
+	/* A waiter runs a task submitted while it sleeps, when the only worker is busy */
+	pool = ThreadPool_Create(1);
+	ASSERT(pool != NULL);
+	pipe_t pipe;
+	ASSERT(Pipe(&pipe)==0);
+	static volatile int started;
+	started = 0;
+	int blocked(int argl, void* args) {
+		char c;
+		started = 1;
+		return Read(pipe.read, &c, 1);
+	}
+	int unblock(int argl, void* args) {
+		return Write(pipe.write, "x", 1);
+	}
+	int submitter(int argl, void* args) {
+		Sleep(50000);
+		tasks[1] = ThreadPool_Submit(pool, unblock, 0, NULL);
+		return 0;
+	}
+	tasks[0] = ThreadPool_Submit(pool, blocked, 0, NULL);
+	while(! started) Sleep(1000);
+	Tid_t t = CreateThread(submitter, 0, NULL);
+	int retval;
+	ThreadPool_Wait(tasks[0], &retval);
+	ASSERT(retval==1);
+	ASSERT(ThreadJoin(t, NULL)==0);
+	ThreadPool_Wait(tasks[1], &retval);
+	ASSERT(retval==1);
+	ASSERT(Close(pipe.read)==0);
+	ASSERT(Close(pipe.write)==0);
+
+	ThreadPool_Destroy(pool);
+	return 0;
+}
+
+
+BOOT_TEST(test_thread_local_storage,
+	"Test that thread-local storage keys hold a separate value for each thread, "
+	"and that destructors run when threads exit."
+	)
+{
+	tls_key_t key, key2;
+	static int destroyed;
+	destroyed = 0;
+
+	void dtor(void* value) {
+		ASSERT(value != NULL);
+		__atomic_fetch_add(&destroyed, 1, __ATOMIC_SEQ_CST);
+	}
+
+	ASSERT(TLSKeyCreate(&key, dtor)==0);
+	ASSERT(TLSKeyCreate(&key2, NULL)==0);
+	ASSERT(key != key2);
+	ASSERT(TLSGet(key)==NULL);
+	ASSERT(TLSSet(MAX_TLS_KEYS, &key)==-1);
+
+	int task(int argl, void* args) {
+		int mine[2];
+		ASSERT(TLSGet(key)==NULL);
+		ASSERT(TLSSet(key, &mine[0])==0);
+		ASSERT(TLSSet(key2, &mine[1])==0);
+		for(int i=0;i<100;i++) {
+			ASSERT(TLSGet(key)==&mine[0]);
+			ASSERT(TLSGet(key2)==&mine[1]);
+		}
+		return 0;
+	}
+
+	Tid_t tids[10];
+	for(int i=0;i<10;i++) 
+		tids[i] = CreateThread(task, 0, NULL);
+	for(int i=0;i<10;i++) 
+		ASSERT(ThreadJoin(tids[i], NULL)==0);
+	ASSERT(destroyed==10);
+
+	/* A deleted key is reused, and its values are cleared and no longer destroyed */
+	ASSERT(TLSSet(key, &key2)==0);
+	ASSERT(TLSKeyDelete(key)==0);
+	ASSERT(TLSKeyDelete(key)==-1);
+	ASSERT(TLSSet(key, &key)==-1);
+	tls_key_t key3;
+	ASSERT(TLSKeyCreate(&key3, NULL)==0);
+	ASSERT(key3==key);
+	ASSERT(TLSGet(key3)==NULL);
+	Tid_t t = CreateThread(task, 0, NULL);
+	ASSERT(ThreadJoin(t, NULL)==0);
+	ASSERT(destroyed==10);
+	return 0;
+}
+
+
+BOOT_TEST(test_fibers,
+	"Test that fibers are multiplexed on carrier threads, and that a fiber "
+	"blocked on I/O does not block the other fibers of its carrier."
+	)
+{
+	static int counter;
+	counter = 0;
+
+	FiberScheduler* sched = FiberScheduler_Create(2);
+	ASSERT(sched != NULL);
+
+	int count(int argl, void* args) {
+		for(int i=0;i<argl;i++) {
+			__atomic_fetch_add(&counter, 1, __ATOMIC_SEQ_CST);
+			Fiber_Yield(sched);
+		}
+		return 0;
+	}
+	for(int i=0;i<1000;i++)
+		ASSERT(Fiber_Spawn(sched, count, 5, NULL)==0);
+	FiberScheduler_Destroy(sched);
+	ASSERT(counter==5000);
+
+	/* With one carrier, the reader parks and the writer runs */
+	sched = FiberScheduler_Create(1);
+	pipe_t pipe;
+	ASSERT(Pipe(&pipe)==0);
+	static char buffer[6];
+
+	int reader(int argl, void* args) {
+		ASSERT(Fiber_Read(sched, pipe.read, buffer, 6)==6);
+		return 0;
+	}
+	int writer(int argl, void* args) {
+		Fiber_Yield(sched);
+		ASSERT(Fiber_Write(sched, pipe.write, "hello", 6)==6);
+		ASSERT(Close(pipe.write)==0);
+		return 0;
+	}
+	ASSERT(Fiber_Spawn(sched, reader, 0, NULL)==0);
+	ASSERT(Fiber_Spawn(sched, writer, 0, NULL)==0);
+	FiberScheduler_Destroy(sched);
+	ASSERT(strcmp(buffer, "hello")==0);
+	ASSERT(Close(pipe.read)==0);
+
+	/* Fiber I/O does not leave the stream in non-blocking mode */
+	ASSERT(Pipe(&pipe)==0);
+	sched = FiberScheduler_Create(1);
+	int echo(int argl, void* args) {
+		ASSERT(Fiber_Write(sched, pipe.write, "a", 1)==1);
+		ASSERT(Fiber_Read(sched, pipe.read, buffer, 1)==1 && buffer[0]=='a');
+		return 0;
+	}
+	ASSERT(Fiber_Spawn(sched, echo, 0, NULL)==0);
+	FiberScheduler_Destroy(sched);
+	int late_writer(int argl, void* args) {
+		Sleep(20000);
+		return Write(pipe.write, "b", 1);
+	}
+	Tid_t t = CreateThread(late_writer, 0, NULL);
+	ASSERT(Read(pipe.read, buffer, 1)==1 && buffer[0]=='b');
+	ASSERT(ThreadJoin(t, NULL)==0);
+	ASSERT(ReadNonBlock(pipe.read, buffer, 1)==WOULD_BLOCK);
+	ASSERT(Close(pipe.read)==0 && Close(pipe.write)==0);
+
+	/* Parked fibers do not cost a thread each */
+	unsigned long thread_count() {
+		Fid_t finfo = OpenInfo();
+		procinfo info;
+		unsigned long n = 0;
+		while(Read(finfo, (char*)&info, sizeof(info))==sizeof(info))
+			if(info.pid==GetPid()) n = info.thread_count;
+		Close(finfo);
+		return n;
+	}
+	const int N = 100;
+	static pipe_t pipes[100];
+	static int done;
+	done = 0;
+	for(int i=0;i<N;i++)
+		ASSERT(Pipe(&pipes[i])==0);
+	sched = FiberScheduler_Create(1);
+	int pipe_reader(int argl, void* args) {
+		char c;
+		ASSERT(Fiber_Read(sched, pipes[argl].read, &c, 1)==1 && c=='a'+argl%26);
+		__atomic_fetch_add(&done, 1, __ATOMIC_SEQ_CST);
+		return 0;
+	}
+	for(int i=0;i<N;i++)
+		ASSERT(Fiber_Spawn(sched, pipe_reader, i, NULL)==0);
+	Sleep(50000);
+	ASSERT(done==0);
+	ASSERT(thread_count() <= 3);
+	for(int i=0;i<N;i++) {
+		char c = 'a'+i%26;
+		ASSERT(Write(pipes[i].write, &c, 1)==1);
+	}
+	FiberScheduler_Destroy(sched);
+	ASSERT(done==N);
+	for(int i=0;i<N;i++)
+		ASSERT(Close(pipes[i].read)==0 && Close(pipes[i].write)==0);
+	return 0;
+}
+
+
+BOOT_TEST(test_join_any_and_futures,
+	"Test that ThreadJoinAny joins the first thread to exit, and that WaitAny "
+	"returns the futures of threads as they complete."
+	)
+{
+	static int release;
+	release = 0;
+
+	int task(int argl, void* args) {
+		while(! __atomic_load_n(&release, __ATOMIC_SEQ_CST) && argl != 2)
+			ThreadJoin(NOTHREAD, NULL);   /* A cheap system call, to let others run */
+		return argl;
+	}
+
+	Tid_t tids[4];
+	for(int i=0;i<4;i++)
+		tids[i] = CreateThread(task, i, NULL);
+
+	/* Only thread 2 can finish */
+	int exitval;
+	ASSERT(ThreadJoinAny(tids, 4, &exitval)==tids[2]);
+	ASSERT(exitval==2);
+	ASSERT(ThreadJoin(tids[2], NULL)==-1);
+	ASSERT(ThreadJoinAny(NULL, 4, NULL)==NOTHREAD);
+	Tid_t self = ThreadSelf();
+	ASSERT(ThreadJoinAny(&self, 1, NULL)==NOTHREAD);
+
+	/* A long array, with the same tid many times */
+	const unsigned int M = 100000;
+	Tid_t* many = malloc(M*sizeof(Tid_t));
+	ASSERT(many!=NULL);
+	Tid_t t2 = CreateThread(task, 2, NULL);
+	for(unsigned int i=0;i<M;i++)
+		many[i] = t2;
+	ASSERT(ThreadJoinAny(many, M, &exitval)==t2 && exitval==2);
+	ASSERT(ThreadJoin(t2, NULL)==-1);
+	free(many);
+
+	__atomic_store_n(&release, 1, __ATOMIC_SEQ_CST);
+	int joined = 0;
+	Tid_t rest[3] = { tids[0], tids[1], tids[3] };
+	for(int k=0;k<3;k++) {
+		Tid_t t = ThreadJoinAny(rest, 3-k, &exitval);
+		ASSERT(t!=NOTHREAD);
+		int i;
+		for(i=0; rest[i]!=t; i++);
+		ASSERT(exitval==(t==tids[0] ? 0 : t==tids[1] ? 1 : 3));
+		joined |= 1<<exitval;
+		rest[i] = rest[2-k];
+	}
+	ASSERT(joined==0xB);
+
+	/* Futures */
+	release = 0;
+	future_t F[4];
+	future_t* futures[4];
+	for(int i=0;i<4;i++) {
+		futures[i] = &F[i];
+		ASSERT(CreateThreadFuture(task, i, NULL, &F[i])!=NOTHREAD);
+	}
+	ASSERT(WaitAny(futures, 4, (timeout_t)-1)==2);
+	ASSERT(F[2].exitval==2);
+	futures[2] = NULL;
+	ASSERT(WaitAny(futures, 4, 0)==-1);
+	ASSERT(WaitAny(futures, 4, 10)==-1);
+
+	__atomic_store_n(&release, 1, __ATOMIC_SEQ_CST);
+	for(int k=0;k<3;k++) {
+		/* A timeout too long to represent does not expire either */
+		int i = WaitAny(futures, 4, (k==0) ? ((timeout_t)-1)/2 : (timeout_t)-1);
+		ASSERT(i>=0 && i!=2);
+		ASSERT(F[i].done && F[i].exitval==i);
+		futures[i] = NULL;
+	}
+	return 0;
+}
+
+
 TEST_SUITE(thread_tests, 
 	"A suite of tests for threads."
 	)
 {
 	&test_create_join_thread,
 	&test_exit_many_threads,
+	&test_recycle_threads_and_processes,
+	&test_join_detach_many_threads,
+	&test_thread_pool,
+	&test_thread_local_storage,
+	&test_fibers,
+	&test_join_any_and_futures,
 	NULL
 };
 
@@ -1193,6 +1788,258 @@ BOOT_TEST(test_pipe_multi_producer,
 }
 
 
+BOOT_TEST(test_pipe_bulk_transfer,
+	"Test that large reads and writes through a pipe, which wrap around the buffer, "
+	"transfer the data intact, and that closing the writer wakes up a blocked reader."
+	)
+{
+	pipe_t pipe;
+	ASSERT(Pipe(&pipe)==0);
+
+	const int N = 1000003;
+	int writer(int argl, void* args) {
+		static char buffer[10007];
+		int sent = 0;
+		while(sent < N) {
+			int n = (N-sent < 10007) ? N-sent : 10007;
+			for(int i=0;i<n;i++) buffer[i] = (char)((sent+i) % 251);
+			ASSERT(Write(pipe.write, buffer, n)==n);
+			sent += n;
+		}
+		ASSERT(Close(pipe.write)==0);
+		return 0;
+	}
+	Tid_t t = CreateThread(writer, 0, NULL);
+
+	static char buffer[6007];
+	int received = 0, rc;
+	while((rc = Read(pipe.read, buffer, 6007)) > 0) {
+		for(int i=0;i<rc;i++) 
+			ASSERT(buffer[i] == (char)((received+i) % 251));
+		received += rc;
+	}
+	ASSERT(rc==0);
+	ASSERT(received==N);
+	ASSERT(ThreadJoin(t, NULL)==0);
+	ASSERT(Close(pipe.read)==0);
+	return 0;
+}
+
+
+BOOT_TEST(test_pipe_short_read_and_low_water,
+	"Test that Read on a pipe returns as soon as some data is available, "
+	"and that it waits for the low-water mark when one is set."
+	)
+{
+	pipe_t pipe;
+	ASSERT(Pipe(&pipe)==0);
+	char buffer[100];
+
+	ASSERT(Write(pipe.write, "abc", 3)==3);
+	ASSERT(Read(pipe.read, buffer, 100)==3);
+	ASSERT(memcmp(buffer, "abc", 3)==0);
+
+	ASSERT(SetLowWater(pipe.read, 0)==-1);
+	ASSERT(SetLowWater(pipe.write, 10)==-1);
+	ASSERT(SetLowWater(pipe.read, 10)==0);
+
+	/* The reader waits until 10 bytes have arrived, in two writes */
+	int writer(int argl, void* args) {
+		ASSERT(Write(pipe.write, "01234", 5)==5);
+		ASSERT(Write(pipe.write, "56789xy", 7)==7);
+		return 0;
+	}
+	Tid_t t = CreateThread(writer, 0, NULL);
+	int rc = Read(pipe.read, buffer, 100);
+	ASSERT(rc>=10 && rc<=12);
+	ASSERT(memcmp(buffer, "0123456789", 10)==0);
+	ASSERT(ThreadJoin(t, NULL)==0);
+
+	/* A smaller buffer than the mark is filled, and end of file returns early */
+	if(rc < 12) {
+		ASSERT(Read(pipe.read, buffer, 12-rc)==12-rc);
+	}
+	ASSERT(Write(pipe.write, "abc", 3)==3);
+	ASSERT(Close(pipe.write)==0);
+	ASSERT(Read(pipe.read, buffer, 100)==3);
+	ASSERT(Read(pipe.read, buffer, 100)==0);
+	return 0;
+}
+
+
+BOOT_TEST(test_pipe_set_size,
+	"Test that the capacity of a pipe can be changed, and that a writer can "
+	"fill the whole capacity without blocking."
+	)
+{
+	pipe_t pipe;
+	ASSERT(Pipe(&pipe)==0);
+
+	ASSERT(SetPipeSize(pipe.write, 0)==-1);
+	ASSERT(SetPipeSize(pipe.write, 1<<30)==-1);
+	ASSERT(SetPipeSize(NOFILE, 4096)==-1);
+	Fid_t fnull = OpenNull();
+	ASSERT(SetPipeSize(fnull, 4096)==-1);
+	ASSERT(Close(fnull)==0);
+
+	/* The size is rounded up to whole chunks */
+	int cap = SetPipeSize(pipe.write, 5000);
+	ASSERT(cap >= 5000 && cap < 2*5000);
+
+	static char wbuf[100000], rbuf[100000];
+	for(int i=0;i<100000;i++) wbuf[i] = i % 251;
+
+	ASSERT(Write(pipe.write, wbuf, cap)==cap);
+
+	/* Shrinking keeps the data */
+	ASSERT(SetPipeSize(pipe.read, 4096)==4096);
+	ASSERT(Read(pipe.read, rbuf, 100000)==cap);
+	ASSERT(memcmp(rbuf, wbuf, cap)==0);
+
+	/* A large pipe takes a large write at once */
+	ASSERT(SetPipeSize(pipe.read, 100000)>=100000);
+	ASSERT(Write(pipe.write, wbuf, 100000)==100000);
+	ASSERT(Close(pipe.write)==0);
+	int count = 0, rc;
+	while((rc = Read(pipe.read, rbuf+count, 100000-count))>0) count += rc;
+	ASSERT(count==100000);
+	ASSERT(memcmp(rbuf, wbuf, 100000)==0);
+	return 0;
+}
+
+
+BOOT_TEST(test_pipe_spsc_switch,
+	"Test that a pipe keeps the data in order when a second reader appears in "
+	"the middle of a transfer, that concurrent readers share the data, and that "
+	"a child sharing the file id table can write along with its parent."
+	)
+{
+	pipe_t pipe;
+	ASSERT(Pipe(&pipe)==0);
+
+	const int N = 300007;
+	int writer(int argl, void* args) {
+		char buffer[7919];
+		int sent = 0;
+		while(sent < N) {
+			int n = (N-sent < 7919) ? N-sent : 7919;
+			for(int i=0;i<n;i++) buffer[i] = (char)((sent+i) % 251);
+			ASSERT(Write(pipe.write, buffer, n)==n);
+			sent += n;
+		}
+		if(argl==0)
+			ASSERT(Close(pipe.write)==0);
+		return 0;
+	}
+	Tid_t t = CreateThread(writer, 0, NULL);
+
+	/* Read a third of the data, then read through two file ids */
+	static char buffer[5003];
+	int received = 0, rc;
+	while(received < N/3 && (rc = Read(pipe.read, buffer, 5003)) > 0) {
+		for(int i=0;i<rc;i++) 
+			ASSERT(buffer[i] == (char)((received+i) % 251));
+		received += rc;
+	}
+	Fid_t rdup = MAX_FILEID-1;
+	ASSERT(Dup2(pipe.read, rdup)==0);
+	int turn = 0;
+	while((rc = Read((turn++ & 1) ? rdup : pipe.read, buffer, 5003)) > 0) {
+		for(int i=0;i<rc;i++) 
+			ASSERT(buffer[i] == (char)((received+i) % 251));
+		received += rc;
+	}
+	ASSERT(rc==0);
+	ASSERT(received==N);
+	ASSERT(ThreadJoin(t, NULL)==0);
+	ASSERT(Close(pipe.read)==0);
+	ASSERT(Close(rdup)==0);
+
+	/* Two threads read from the same file id */
+	ASSERT(Pipe(&pipe)==0);
+	t = CreateThread(writer, 0, NULL);
+	int reader(int argl, void* args) {
+		static char rbuf[2][3001];
+		int total = 0, rc;
+		while((rc = Read(pipe.read, rbuf[argl], 3001)) > 0) 
+			total += rc;
+		return total;
+	}
+	Tid_t r1 = CreateThread(reader, 0, NULL);
+	Tid_t r2 = CreateThread(reader, 1, NULL);
+	int n1, n2;
+	ASSERT(ThreadJoin(r1, &n1)==0);
+	ASSERT(ThreadJoin(r2, &n2)==0);
+	ASSERT(n1+n2==N);
+	ASSERT(ThreadJoin(t, NULL)==0);
+	ASSERT(Close(pipe.read)==0);
+
+	/* A child that shares our file id table writes along with us */
+	ASSERT(Pipe(&pipe)==0);
+	r1 = CreateThread(reader, 0, NULL);
+	t = CreateThread(writer, 1, NULL);
+	Pid_t child = Exec(writer, 1, NULL);
+	ASSERT(child != NOPROC);
+	ASSERT(ThreadJoin(t, NULL)==0);
+	ASSERT(WaitChild(child, NULL)==child);
+	ASSERT(Close(pipe.write)==0);
+	ASSERT(ThreadJoin(r1, &n1)==0);
+	ASSERT(n1==2*N);
+	ASSERT(Close(pipe.read)==0);
+	return 0;
+}
+
+
+BOOT_TEST(test_readv_writev,
+	"Test that ReadV and WriteV gather and scatter the data of a pipe in order, "
+	"and fall back to Read and Write on other streams."
+	)
+{
+	pipe_t pipe;
+	ASSERT(Pipe(&pipe)==0);
+
+	int hdr = 11;
+	char body[] = "hello world";
+	iovec_t out[3] = { { &hdr, sizeof(hdr) }, { NULL, 0 }, { body, 11 } };
+
+	ASSERT(WriteV(pipe.write, NULL, 1)==-1);
+	ASSERT(WriteV(pipe.write, out, MAX_IOV+1)==-1);
+	ASSERT(WriteV(pipe.read, out, 3)==-1);
+	ASSERT(ReadV(pipe.write, out, 3)==-1);
+
+	ASSERT(WriteV(pipe.write, out, 3)==sizeof(hdr)+11);
+
+	/* Scatter the message over differently sized buffers */
+	int rhdr;
+	char rbody[20];
+	SetLowWater(pipe.read, sizeof(hdr)+11);
+	iovec_t in[2] = { { &rhdr, sizeof(rhdr) }, { rbody, 20 } };
+	ASSERT(ReadV(pipe.read, in, 2)==sizeof(hdr)+11);
+	ASSERT(rhdr==11);
+	ASSERT(memcmp(rbody, body, 11)==0);
+
+	/* The same through the locked path, after a Dup2 */
+	ASSERT(Dup2(pipe.write, MAX_FILEID-1)==0);
+	ASSERT(WriteV(MAX_FILEID-1, out, 3)==sizeof(hdr)+11);
+	ASSERT(Close(MAX_FILEID-1)==0);
+	ASSERT(Close(pipe.write)==0);
+	rhdr = 0;
+	ASSERT(ReadV(pipe.read, in, 2)==sizeof(hdr)+11);
+	ASSERT(rhdr==11);
+	ASSERT(memcmp(rbody, body, 11)==0);
+	ASSERT(ReadV(pipe.read, in, 2)==0);
+	ASSERT(Close(pipe.read)==0);
+
+	/* The null device has no vectored operations */
+	Fid_t fnull = OpenNull();
+	ASSERT(WriteV(fnull, out, 3)==sizeof(hdr)+11);
+	ASSERT(ReadV(fnull, in, 2)==sizeof(rhdr)+20);
+	ASSERT(rhdr==0);
+	ASSERT(Close(fnull)==0);
+	return 0;
+}
+
+
 TEST_SUITE(pipe_tests,
 	"A suite of tests for pipes. We are focusing on correctness, not performance."
 	)
@@ -1203,6 +2050,11 @@ TEST_SUITE(pipe_tests,
 	&test_pipe_close_writer,
 	&test_pipe_single_producer,
 	&test_pipe_multi_producer,
+	&test_pipe_bulk_transfer,
+	&test_pipe_short_read_and_low_water,
+	&test_pipe_set_size,
+	&test_pipe_spsc_switch,
+	&test_readv_writev,
 	NULL
 };
 
@@ -1472,6 +2324,36 @@ BOOT_TEST(test_accept_unblocks_on_close,
 }
 
 
+BOOT_TEST(test_accept_survives_closed_fid,
+	"Test that Accept keeps waiting if its file id is closed while "
+	"another file id keeps the listening socket open."
+	)
+{
+	Fid_t lsock = Socket(100);
+	ASSERT(lsock!=NOFILE);
+	ASSERT(Listen(lsock)==0);
+	ASSERT(Dup2(lsock, 5)==0);
+
+	int accept_connection(int argl, void* args) {
+		Fid_t s = Accept(lsock);
+		ASSERT(s!=NOFILE);
+		ASSERT(Close(s)==0);
+		return 0;
+	}
+	Tid_t t = CreateThread(accept_connection, 0, NULL);
+
+	Sleep(50000);
+	ASSERT(Close(lsock)==0);
+	Fid_t cli = Socket(NOPORT);
+	ASSERT(Connect(cli, 100, 1000)==0);
+
+	ASSERT(ThreadJoin(t,NULL)==0);
+	ASSERT(Close(cli)==0);
+	ASSERT(Close(5)==0);
+	return 0;
+}
+
+
 BOOT_TEST(test_connect_fails_on_bad_fid,
 	"Test that Connect will fail if given a bad fid."
 	)
@@ -1672,6 +2554,9 @@ BOOT_TEST(test_shudown_read,
 
 	ASSERT(Write(srv, "Hello world",12)==12);
 
+	ASSERT(ShutDown(NOFILE, SHUTDOWN_READ)==-1);
+	ASSERT(ShutDown(OpenNull(), SHUTDOWN_READ)==-1);
+
 	ShutDown(cli, SHUTDOWN_READ);
 	char buffer[12];
 	ASSERT(Read(cli, buffer, 12)==-1);
@@ -1730,6 +2615,628 @@ BOOT_TEST(test_shudown_write,
 
 
 
+BOOT_TEST(test_socket_low_water,
+	"Test that Read on a socket returns short reads, and that its low-water mark "
+	"can be set before it is connected."
+	)
+{
+	Fid_t lsock = Socket(100);
+	ASSERT(Listen(lsock)==0);
+	Fid_t cli = Socket(NOPORT), srv;
+	ASSERT(SetLowWater(cli, 5)==0);
+	connect_sockets(cli, lsock, &srv, 100);
+
+	char buffer[100];
+	ASSERT(Write(cli, "ping", 5)==5);
+	ASSERT(Read(srv, buffer, 100)==5);
+	ASSERT(strcmp(buffer, "ping")==0);
+
+	int server(int argl, void* args) {
+		ASSERT(Write(srv, "po", 2)==2);
+		ASSERT(Write(srv, "ng", 3)==3);
+		return 0;
+	}
+	Tid_t t = CreateThread(server, 0, NULL);
+	ASSERT(Read(cli, buffer, 100)==5);
+	ASSERT(strcmp(buffer, "pong")==0);
+	ASSERT(ThreadJoin(t, NULL)==0);
+	return 0;
+}
+
+
+BOOT_TEST(test_splice,
+	"Test that Splice moves data between pipes and sockets, and through a kernel "
+	"buffer for other streams."
+	)
+{
+	pipe_t p1, p2;
+	ASSERT(Pipe(&p1)==0);
+	ASSERT(Pipe(&p2)==0);
+	char buffer[100];
+
+	/* Pipe to pipe */
+	ASSERT(Write(p1.write, "Hello world", 12)==12);
+	ASSERT(Splice(p1.read, p2.write, 5)==5);
+	ASSERT(Splice(p1.read, p2.write, 100)==7);
+	ASSERT(Read(p2.read, buffer, 100)==12);
+	ASSERT(strcmp(buffer, "Hello world")==0);
+
+	/* Wrong directions */
+	ASSERT(Splice(p1.write, p2.write, 10)==-1);
+	ASSERT(Splice(p1.read, p2.read, 10)==-1);
+
+	/* Pipe to socket and back, across threads */
+	Fid_t lsock = Socket(100);
+	ASSERT(Listen(lsock)==0);
+	Fid_t cli = Socket(NOPORT), srv;
+	connect_sockets(cli, lsock, &srv, 100);
+
+	const int N = 100000;
+	int producer(int argl, void* args) {
+		char data[1000];
+		for(int i=0;i<N;i+=1000) {
+			for(int j=0;j<1000;j++) data[j] = (char)((i+j)%127);
+			ASSERT(Write(p1.write, data, 1000)==1000);
+		}
+		ASSERT(Close(p1.write)==0);
+		return 0;
+	}
+	int forwarder(int argl, void* args) {
+		int rc;
+		while((rc = Splice(p1.read, cli, 4096)) > 0);
+		ASSERT(rc==0);
+		ASSERT(ShutDown(cli, SHUTDOWN_WRITE)==0);
+		return 0;
+	}
+	Tid_t t1 = CreateThread(producer, 0, NULL);
+	Tid_t t2 = CreateThread(forwarder, 0, NULL);
+
+	int received = 0, rc;
+	while((rc = Read(srv, buffer, 100)) > 0) {
+		for(int j=0;j<rc;j++)
+			ASSERT(buffer[j] == (char)((received+j)%127));
+		received += rc;
+	}
+	ASSERT(received==N);
+	ASSERT(ThreadJoin(t1, NULL)==0);
+	ASSERT(ThreadJoin(t2, NULL)==0);
+
+	/* From the null device, through the kernel buffer */
+	Fid_t null = OpenNull();
+	ASSERT(Splice(null, p2.write, 50)==50);
+	ASSERT(Read(p2.read, buffer, 100)==50);
+	for(int j=0;j<50;j++) ASSERT(buffer[j]==0);
+
+	/* Message streams are refused, without taking any input */
+	Fid_t mq = MsgQueue(4, 16);
+	ASSERT(Write(p2.write, "message", 8)==8);
+	ASSERT(Splice(p2.read, mq, 100)==-1);
+	ASSERT(ReadNonBlock(mq, buffer, 100)==WOULD_BLOCK);
+	ASSERT(Read(p2.read, buffer, 100)==8);
+	ASSERT(MsgSend(mq, "message", 8, 0)==0);
+	ASSERT(Splice(mq, p2.write, 100)==-1);
+	ASSERT(Read(mq, buffer, 100)==8);
+
+	/* An output without a reader is refused before reading */
+	pipe_t p3;
+	ASSERT(Pipe(&p3)==0);
+	ASSERT(Close(p3.read)==0);
+	ASSERT(Write(p2.write, "data", 5)==5);
+	ASSERT(Splice(p2.read, p3.write, 100)==-1);
+	ASSERT(Splice(null, p3.write, 100)==-1);
+	ASSERT(Read(p2.read, buffer, 100)==5);
+	return 0;
+}
+
+
+BOOT_TEST(test_message_queue,
+	"Test that a message queue keeps message boundaries and priorities, "
+	"and that senders block on a full queue."
+	)
+{
+	ASSERT(MsgQueue(0, 10)==NOFILE);
+	ASSERT(MsgQueue(10, 0)==NOFILE);
+	ASSERT(MsgQueue(10, MSGQ_MAX_MSGSIZE+1)==NOFILE);
+
+	Fid_t mq = MsgQueue(4, 16);
+	ASSERT(mq!=NOFILE);
+
+	pipe_t pipe;
+	ASSERT(Pipe(&pipe)==0);
+	ASSERT(MsgSend(pipe.write, "x", 1, 0)==-1);
+	ASSERT(MsgSend(mq, "x", 1, MSGQ_PRIORITIES)==-1);
+	ASSERT(MsgSend(mq, "01234567890123456", 17, 0)==-1);
+
+	/* Higher priorities first, in order within a priority */
+	ASSERT(MsgSend(mq, "low", 3, 0)==0);
+	ASSERT(MsgSend(mq, "high1", 5, 7)==0);
+	ASSERT(Write(mq, "low2", 4)==4);
+	ASSERT(MsgSend(mq, "high2", 5, 7)==0);
+
+	char buf[16];
+	unsigned int prio;
+	ASSERT(MsgReceive(mq, buf, 4, &prio)==-1);   /* too small, the message stays */
+	ASSERT(MsgReceive(mq, buf, 16, &prio)==5 && prio==7 && memcmp(buf, "high1", 5)==0);
+	ASSERT(MsgReceive(mq, buf, 16, &prio)==5 && prio==7 && memcmp(buf, "high2", 5)==0);
+	ASSERT(Read(mq, buf, 16)==3 && memcmp(buf, "low", 3)==0);
+	ASSERT(MsgReceive(mq, buf, 16, NULL)==4 && memcmp(buf, "low2", 4)==0);
+
+	/* An empty write sends nothing, an empty MsgSend sends an empty message */
+	ASSERT(Write(mq, NULL, 0)==0);
+	ASSERT(ReadNonBlock(mq, buf, 16)==WOULD_BLOCK);
+	ASSERT(MsgSend(mq, NULL, 0, 1)==0);
+	ASSERT(MsgReceive(mq, buf, 16, &prio)==0 && prio==1);
+
+	/* A sender blocks when the queue is full */
+	int sender(int argl, void* args) {
+		for(int i=0;i<100;i++)
+			ASSERT(MsgSend(mq, &i, sizeof(i), i % MSGQ_PRIORITIES)==0);
+		return 0;
+	}
+	Tid_t t = CreateThread(sender, 0, NULL);
+	int seen[100] = { 0 };
+	for(int i=0;i<100;i++) {
+		int msg;
+		ASSERT(MsgReceive(mq, &msg, sizeof(msg), &prio)==sizeof(msg));
+		ASSERT(msg>=0 && msg<100 && prio == msg % MSGQ_PRIORITIES);
+		seen[msg]++;
+	}
+	for(int i=0;i<100;i++) 
+		ASSERT(seen[i]==1);
+	ASSERT(ThreadJoin(t, NULL)==0);
+
+	/* Each receive wakes up one of several blocked senders */
+	Fid_t mq2 = MsgQueue(2, 4);
+	ASSERT(MsgSend(mq2, "a", 1, 0)==0 && MsgSend(mq2, "b", 1, 0)==0);
+	int one_sender(int argl, void* args) {
+		ASSERT(MsgSend(mq2, "c", 1, 0)==0);
+		return 0;
+	}
+	Tid_t t1 = CreateThread(one_sender, 0, NULL);
+	Tid_t t2 = CreateThread(one_sender, 0, NULL);
+	Sleep(50000);
+	for(int i=0;i<4;i++)
+		ASSERT(MsgReceive(mq2, buf, 16, NULL)==1);
+	ASSERT(ThreadJoin(t1, NULL)==0 && ThreadJoin(t2, NULL)==0);
+	ASSERT(Close(mq2)==0);
+
+	ASSERT(Close(mq)==0);
+	ASSERT(Close(pipe.read)==0);
+	ASSERT(Close(pipe.write)==0);
+	return 0;
+}
+
+
+BOOT_TEST(test_poll,
+	"Test that Poll reports the ready streams, sleeps until one is ready, "
+	"and times out."
+	)
+{
+	pipe_t pipe;
+	ASSERT(Pipe(&pipe)==0);
+	Fid_t mq = MsgQueue(1, 4);
+	ASSERT(mq!=NOFILE);
+
+	ASSERT(Poll(NULL, 1, 0)==-1);
+	ASSERT(Poll(NULL, 0, 0)==-1);
+
+	pollfd_t fds[4] = {
+		{ .fd = pipe.read, .events = POLL_READ },
+		{ .fd = pipe.write, .events = POLL_WRITE },
+		{ .fd = NOFILE, .events = POLL_READ },
+		{ .fd = mq, .events = POLL_READ|POLL_WRITE }
+	};
+
+	/* Only the writable ends are ready */
+	ASSERT(Poll(fds, 4, 0)==2);
+	ASSERT(fds[0].revents==0 && fds[1].revents==POLL_WRITE && fds[2].revents==0);
+	ASSERT(fds[3].revents==POLL_WRITE);
+
+	/* A message fills the queue */
+	ASSERT(MsgSend(mq, "m", 1, 0)==0);
+	ASSERT(Poll(fds+3, 1, 0)==1 && fds[3].revents==POLL_READ);
+
+	/* Nothing to read, time out */
+	ASSERT(Poll(fds, 1, 20)==0 && fds[0].revents==0);
+
+	/* A writer wakes up the poller */
+	int writer(int argl, void* args) {
+		Mutex mx = MUTEX_INIT;
+		CondVar cv = COND_INIT;
+		Mutex_Lock(&mx);
+		Cond_TimedWait(&mx, &cv, 50);
+		Mutex_Unlock(&mx);
+		ASSERT(Write(pipe.write, "hello", 5)==5);
+		return 0;
+	}
+	Tid_t t = CreateThread(writer, 0, NULL);
+	ASSERT(Poll(fds, 1, (timeout_t)-1)==1 && fds[0].revents==POLL_READ);
+	ASSERT(ThreadJoin(t, NULL)==0);
+	char buf[8];
+	ASSERT(Read(pipe.read, buf, 8)==5);
+
+	/* Closing the writer hangs up the reader */
+	ASSERT(Close(pipe.write)==0);
+	ASSERT(Poll(fds, 1, 0)==1 && fds[0].revents==(POLL_READ|POLL_HANGUP));
+
+	/* A closed file id is invalid */
+	ASSERT(Poll(fds+1, 1, 0)==1 && fds[1].revents==POLL_INVALID);
+
+	/* A listener is readable when a peer connects, a peer when data arrives */
+	Fid_t lsock = Socket(100);
+	ASSERT(Listen(lsock)==0);
+	pollfd_t lfd = { .fd = lsock, .events = POLL_READ };
+	ASSERT(Poll(&lfd, 1, 0)==0);
+
+	int client(int argl, void* args) {
+		Fid_t cli = Socket(NOPORT);
+		ASSERT(Connect(cli, 100, 1000)==0);
+		pollfd_t cfd = { .fd = cli, .events = POLL_READ|POLL_WRITE };
+		ASSERT(Poll(&cfd, 1, (timeout_t)-1)==1 && (cfd.revents & POLL_READ));
+		ASSERT(Read(cli, buf, 8)==2);
+		Close(cli);
+		return 0;
+	}
+	t = CreateThread(client, 0, NULL);
+	ASSERT(Poll(&lfd, 1, 1000)==1 && lfd.revents==POLL_READ);
+	Fid_t srv = Accept(lsock);
+	ASSERT(srv!=NOFILE);
+	pollfd_t sfd = { .fd = srv, .events = POLL_READ|POLL_WRITE };
+	ASSERT(Poll(&sfd, 1, 0)==1 && sfd.revents==POLL_WRITE);
+	ASSERT(Write(srv, "hi", 2)==2);
+	ASSERT(ThreadJoin(t, NULL)==0);
+
+	ASSERT(Close(srv)==0);
+	ASSERT(Close(lsock)==0);
+	ASSERT(Close(pipe.read)==0);
+	ASSERT(Close(mq)==0);
+	return 0;
+}
+
+
+BOOT_TEST(test_event_set,
+	"Test that an event set reports the streams that become ready, "
+	"once per change."
+	)
+{
+	const int N = 20;
+	pipe_t pipes[N];
+	for(int i=0;i<N;i++)
+		ASSERT(Pipe(&pipes[i])==0);
+
+	Fid_t es = EventSet();
+	ASSERT(es!=NOFILE);
+
+	Fid_t null = OpenNull();
+	ASSERT(EventCtl(pipes[0].read, EVENT_ADD, pipes[0].read, POLL_READ)==-1);
+	ASSERT(EventCtl(es, EVENT_ADD, null, POLL_READ)==-1);
+	ASSERT(EventCtl(es, EVENT_ADD, es, POLL_READ)==-1);
+	ASSERT(EventCtl(es, EVENT_DEL, pipes[0].read, 0)==-1);
+	ASSERT(Close(null)==0);
+
+	for(int i=0;i<N;i++)
+		ASSERT(EventCtl(es, EVENT_ADD, pipes[i].read, POLL_READ)==0);
+	ASSERT(EventCtl(es, EVENT_ADD, pipes[0].read, POLL_READ)==-1);
+
+	event_t ev[N];
+	ASSERT(EventWait(es, NULL, 1, 0)==-1);
+	ASSERT(EventWait(es, ev, 0, 0)==-1);
+	ASSERT(EventWait(es, ev, N, 0)==0);
+	ASSERT(EventWait(es, ev, N, 20)==0);
+
+	/* Only the pipes written to are reported */
+	ASSERT(Write(pipes[3].write, "a", 1)==1);
+	ASSERT(Write(pipes[7].write, "b", 1)==1);
+	ASSERT(EventWait(es, ev, N, 0)==2);
+	ASSERT(ev[0].fd==pipes[3].read && ev[0].events==POLL_READ);
+	ASSERT(ev[1].fd==pipes[7].read && ev[1].events==POLL_READ);
+
+	/* Edge-triggered: unread data is not reported again, until more arrives */
+	ASSERT(EventWait(es, ev, N, 0)==0);
+	ASSERT(Write(pipes[3].write, "c", 1)==1);
+	ASSERT(EventWait(es, ev, 1, 0)==1 && ev[0].fd==pipes[3].read);
+
+	/* A stream that is ready when added is reported */
+	ASSERT(EventCtl(es, EVENT_ADD, pipes[5].write, POLL_WRITE)==0);
+	ASSERT(EventWait(es, ev, N, 0)==1 && ev[0].fd==pipes[5].write && ev[0].events==POLL_WRITE);
+
+	/* A writer wakes up the waiter */
+	int writer(int argl, void* args) {
+		Mutex mx = MUTEX_INIT;
+		CondVar cv = COND_INIT;
+		Mutex_Lock(&mx);
+		Cond_TimedWait(&mx, &cv, 50);
+		Mutex_Unlock(&mx);
+		ASSERT(Write(pipes[argl].write, "x", 1)==1);
+		return 0;
+	}
+	Tid_t t = CreateThread(writer, 11, NULL);
+	ASSERT(EventWait(es, ev, N, (timeout_t)-1)==1 && ev[0].fd==pipes[11].read);
+	ASSERT(ThreadJoin(t, NULL)==0);
+
+	/* Adding a ready stream wakes up the waiter */
+	int adder(int argl, void* args) {
+		Sleep(50000);
+		ASSERT(EventCtl(es, EVENT_ADD, pipes[argl].write, POLL_WRITE)==0);
+		return 0;
+	}
+	t = CreateThread(adder, 13, NULL);
+	ASSERT(EventWait(es, ev, N, (timeout_t)-1)==1 && ev[0].fd==pipes[13].write);
+	ASSERT(ThreadJoin(t, NULL)==0);
+	ASSERT(EventCtl(es, EVENT_DEL, pipes[13].write, 0)==0);
+
+	/* Closing the writer is a hangup */
+	ASSERT(EventCtl(es, EVENT_DEL, pipes[5].write, 0)==0);
+	ASSERT(EventCtl(es, EVENT_MOD, pipes[5].write, POLL_WRITE)==-1);
+	ASSERT(Close(pipes[9].write)==0);
+	ASSERT(EventWait(es, ev, N, 0)==1 && ev[0].fd==pipes[9].read && ev[0].events==(POLL_READ|POLL_HANGUP));
+
+	/* Closing a registered stream drops it from the set, and the set does not keep it open */
+	ASSERT(EventCtl(es, EVENT_ADD, pipes[13].write, POLL_WRITE)==0);
+	ASSERT(Close(pipes[13].write)==0);
+	ASSERT(Close(pipes[9].read)==0);
+	ASSERT(EventWait(es, ev, N, 0)==1 && ev[0].fd==pipes[13].read && ev[0].events==(POLL_READ|POLL_HANGUP));
+	char c;
+	ASSERT(Read(pipes[13].read, &c, 1)==0);
+
+	for(int i=0;i<N;i++) {
+		if(i!=9) ASSERT(Close(pipes[i].read)==0);
+		if(i!=9 && i!=13) ASSERT(Close(pipes[i].write)==0);
+	}
+	ASSERT(Close(es)==0);
+	return 0;
+}
+
+
+BOOT_TEST(test_nonblocking,
+	"Test that streams in non-blocking mode return WOULD_BLOCK instead of waiting."
+	)
+{
+	ASSERT(SetNonBlock(NOFILE, 1)==-1);
+
+	/* Pipes */
+	pipe_t pipe;
+	ASSERT(Pipe(&pipe)==0);
+	ASSERT(SetPipeSize(pipe.write, 4096)==4096);
+	ASSERT(SetNonBlock(pipe.read, 1)==0);
+	ASSERT(SetNonBlock(pipe.write, 1)==0);
+
+	char buf[2*4096];
+	memset(buf, 'x', sizeof(buf));
+	ASSERT(Read(pipe.read, buf, 10)==WOULD_BLOCK);
+	ASSERT(Write(pipe.write, buf, sizeof(buf))==4096);   /* only what fits */
+	ASSERT(Write(pipe.write, buf, 1)==WOULD_BLOCK);
+	iovec_t iov = { .base = buf, .len = 1 };
+	ASSERT(WriteV(pipe.write, &iov, 1)==WOULD_BLOCK);
+	ASSERT(Read(pipe.read, buf, sizeof(buf))==4096);
+	ASSERT(ReadV(pipe.read, &iov, 1)==WOULD_BLOCK);
+
+	/* The mode is shared by duplicates, and can be cleared */
+	ASSERT(Dup2(pipe.read, 20)==0);
+	ASSERT(Read(20, buf, 10)==WOULD_BLOCK);
+	ASSERT(SetNonBlock(20, 0)==0);
+	ASSERT(Write(pipe.write, "abc", 3)==3);
+	ASSERT(Read(pipe.read, buf, 10)==3);
+	ASSERT(Close(20)==0);
+
+	/* End of data is not a would-block */
+	ASSERT(SetNonBlock(pipe.read, 1)==0);
+	ASSERT(Close(pipe.write)==0);
+	ASSERT(Read(pipe.read, buf, 10)==0);
+	ASSERT(Close(pipe.read)==0);
+
+	/* The same for a new pipe, on the lock-free path */
+	const unsigned int cap = 16*4096;
+	char* big = malloc(cap+100);
+	ASSERT(Pipe(&pipe)==0);
+	ASSERT(SetNonBlock(pipe.read, 1)==0);
+	ASSERT(SetNonBlock(pipe.write, 1)==0);
+	ASSERT(Read(pipe.read, big, 10)==WOULD_BLOCK);
+	ASSERT(Write(pipe.write, big, cap+100)==cap);
+	ASSERT(Write(pipe.write, big, 1)==WOULD_BLOCK);
+	ASSERT(Read(pipe.read, big, cap+100)==cap);
+	ASSERT(Read(pipe.read, big, 10)==WOULD_BLOCK);
+	ASSERT(Close(pipe.read)==0);
+	ASSERT(Close(pipe.write)==0);
+	free(big);
+
+	/* Message queues */
+	Fid_t mq = MsgQueue(1, 4);
+	ASSERT(SetNonBlock(mq, 1)==0);
+	ASSERT(MsgReceive(mq, buf, 4, NULL)==WOULD_BLOCK);
+	ASSERT(MsgSend(mq, "m", 1, 0)==0);
+	ASSERT(MsgSend(mq, "m", 1, 0)==WOULD_BLOCK);
+	ASSERT(Write(mq, "m", 1)==WOULD_BLOCK);
+	ASSERT(Read(mq, buf, 4)==1);
+	ASSERT(Close(mq)==0);
+
+	/* Sockets: Accept and Connect do not wait */
+	Fid_t lsock = Socket(100);
+	ASSERT(Listen(lsock)==0);
+	ASSERT(SetNonBlock(lsock, 1)==0);
+	ASSERT(Accept(lsock)==WOULD_BLOCK);
+
+	Fid_t cli = Socket(NOPORT);
+	ASSERT(SetNonBlock(cli, 1)==0);
+	ASSERT(Connect(cli, 100, 1000)==WOULD_BLOCK);
+	ASSERT(Connect(cli, 100, 1000)==-1);     /* already connecting */
+	ASSERT(Read(cli, buf, 1)==WOULD_BLOCK);
+
+	pollfd_t pfd = { .fd = cli, .events = POLL_WRITE };
+	ASSERT(Poll(&pfd, 1, 0)==0);
+	Fid_t srv = Accept(lsock);
+	ASSERT(srv!=NOFILE && srv!=WOULD_BLOCK);
+	ASSERT(Poll(&pfd, 1, 0)==1 && pfd.revents==POLL_WRITE);
+
+	ASSERT(Read(cli, buf, 1)==WOULD_BLOCK);
+	ASSERT(Write(srv, "z", 1)==1);
+	ASSERT(Read(cli, buf, 2)==1 && buf[0]=='z');
+
+	/* A listener that closes hangs up a pending Connect */
+	Fid_t cli2 = Socket(NOPORT);
+	ASSERT(SetNonBlock(cli2, 1)==0);
+	ASSERT(Connect(cli2, 100, 1000)==WOULD_BLOCK);
+	ASSERT(Close(lsock)==0);
+	pfd.fd = cli2;
+	ASSERT(Poll(&pfd, 1, 0)==1 && pfd.revents==POLL_HANGUP);
+
+	/* A socket that closes withdraws its request */
+	lsock = Socket(101);
+	ASSERT(Listen(lsock)==0);
+	Fid_t cli3 = Socket(NOPORT);
+	ASSERT(SetNonBlock(cli3, 1)==0);
+	ASSERT(Connect(cli3, 101, 1000)==WOULD_BLOCK);
+	ASSERT(Close(cli3)==0);
+	ASSERT(SetNonBlock(lsock, 1)==0);
+	ASSERT(Accept(lsock)==WOULD_BLOCK);
+
+	ASSERT(Close(lsock)==0);
+	ASSERT(Close(cli)==0);
+	ASSERT(Close(cli2)==0);
+	ASSERT(Close(srv)==0);
+	return 0;
+}
+
+
+BOOT_TEST(test_event_counter,
+	"Test that an event counter adds on Write, takes on Read, and wakes up "
+	"readers and pollers."
+	)
+{
+	ASSERT(EventFd(0, 2)==NOFILE);
+
+	Fid_t efd = EventFd(3, 0);
+	ASSERT(efd!=NOFILE);
+
+	uint64_t v;
+	ASSERT(Read(efd, (char*)&v, 4)==-1);
+	ASSERT(Read(efd, (char*)&v, 8)==8 && v==3);
+
+	v = 5;
+	ASSERT(Write(efd, (char*)&v, 4)==-1);
+	ASSERT(Write(efd, (char*)&v, 8)==8);
+	ASSERT(Write(efd, (char*)&v, 8)==8);
+	v = UINT64_MAX;
+	ASSERT(Write(efd, (char*)&v, 8)==-1);
+	ASSERT(Read(efd, (char*)&v, 8)==8 && v==10);
+
+	/* Non-blocking */
+	ASSERT(SetNonBlock(efd, 1)==0);
+	ASSERT(Read(efd, (char*)&v, 8)==WOULD_BLOCK);
+	v = UINT64_MAX-1;
+	ASSERT(Write(efd, (char*)&v, 8)==8);
+	v = 1;
+	ASSERT(Write(efd, (char*)&v, 8)==WOULD_BLOCK);
+	ASSERT(Read(efd, (char*)&v, 8)==8 && v==UINT64_MAX-1);
+	ASSERT(SetNonBlock(efd, 0)==0);
+
+	/* A writer wakes up a reader and a poller */
+	int writer(int argl, void* args) {
+		Mutex mx = MUTEX_INIT;
+		CondVar cv = COND_INIT;
+		Mutex_Lock(&mx);
+		Cond_TimedWait(&mx, &cv, 50);
+		Mutex_Unlock(&mx);
+		uint64_t one = 1;
+		for(int i=0;i<argl;i++)
+			ASSERT(Write(efd, (char*)&one, 8)==8);
+		return 0;
+	}
+	Tid_t t = CreateThread(writer, 1, NULL);
+	ASSERT(Read(efd, (char*)&v, 8)==8 && v==1);
+	ASSERT(ThreadJoin(t, NULL)==0);
+
+	pollfd_t pfd = { .fd = efd, .events = POLL_READ };
+	ASSERT(Poll(&pfd, 1, 0)==0);
+	t = CreateThread(writer, 1, NULL);
+	ASSERT(Poll(&pfd, 1, (timeout_t)-1)==1 && pfd.revents==POLL_READ);
+	ASSERT(ThreadJoin(t, NULL)==0);
+	ASSERT(Close(efd)==0);
+
+	/* A semaphore counts down one at a time */
+	efd = EventFd(0, EVENTFD_SEMAPHORE);
+	ASSERT(efd!=NOFILE);
+	t = CreateThread(writer, 100, NULL);
+	for(int i=0;i<100;i++)
+		ASSERT(Read(efd, (char*)&v, 8)==8 && v==1);
+	ASSERT(ThreadJoin(t, NULL)==0);
+	ASSERT(Close(efd)==0);
+	return 0;
+}
+
+
+BOOT_TEST(test_timer_stream,
+	"Test that a timer counts its expirations, wakes up readers, pollers "
+	"and event sets, and can be disarmed."
+	)
+{
+	uint64_t v;
+
+	/* A disarmed timer does not expire */
+	Fid_t tfd = Timer(0, 0);
+	ASSERT(tfd!=NOFILE);
+	ASSERT(Read(tfd, (char*)&v, 4)==-1);
+	ASSERT(Write(tfd, (char*)&v, 8)==-1);
+	ASSERT(SetNonBlock(tfd, 1)==0);
+	ASSERT(Read(tfd, (char*)&v, 8)==WOULD_BLOCK);
+	ASSERT(SetNonBlock(tfd, 0)==0);
+	ASSERT(TimerSet(NOFILE, 1000, 0)==-1);
+	Fid_t nfd = OpenNull();
+	ASSERT(TimerSet(nfd, 1000, 0)==-1);
+	ASSERT(Close(nfd)==0);
+
+	/* One-shot */
+	ASSERT(TimerSet(tfd, 2000, 0)==0);
+	ASSERT(Read(tfd, (char*)&v, 8)==8 && v==1);
+	Sleep(5000);
+	pollfd_t pfd = { .fd = tfd, .events = POLL_READ };
+	ASSERT(Poll(&pfd, 1, 0)==0);
+
+	/* Periodic: the expirations are counted while no one reads */
+	struct timespec t1, t2;
+	clock_gettime(CLOCK_REALTIME, &t1);
+	ASSERT(TimerSet(tfd, 1000, 1000)==0);
+	Sleep(20500);
+	ASSERT(Poll(&pfd, 1, 0)==1 && pfd.revents==POLL_READ);
+	ASSERT(Read(tfd, (char*)&v, 8)==8);
+	clock_gettime(CLOCK_REALTIME, &t2);
+	unsigned long Dt = 1000000ul*(t2.tv_sec-t1.tv_sec) + (t2.tv_nsec/1000ul) - (t1.tv_nsec/1000ul);
+	ASSERT_MSG(v>=20 && v<=Dt/1000, "%lu expirations in %lu usec\n", (unsigned long)v, Dt);
+	ASSERT(Read(tfd, (char*)&v, 8)==8 && v>=1);
+
+	/* Poll and event sets wait for the next expiration */
+	ASSERT(TimerSet(tfd, 10000, 10000)==0);
+	ASSERT(Poll(&pfd, 1, (timeout_t)-1)==1 && pfd.revents==POLL_READ);
+	ASSERT(Read(tfd, (char*)&v, 8)==8 && v>=1);
+
+	Fid_t evset = EventSet();
+	ASSERT(EventCtl(evset, EVENT_ADD, tfd, POLL_READ)==0);
+	event_t ev;
+	for(int i=0; i<3; i++) {
+		ASSERT(EventWait(evset, &ev, 1, 1000)==1 && ev.fd==tfd && ev.events==POLL_READ);
+		ASSERT(Read(tfd, (char*)&v, 8)==8 && v>=1);
+	}
+
+	/* Disarm */
+	ASSERT(TimerSet(tfd, 0, 0)==0);
+	ASSERT(EventWait(evset, &ev, 1, 30)==0);
+	ASSERT(Close(evset)==0);
+	ASSERT(Close(tfd)==0);
+
+	/* Many timers, closed while armed */
+	Fid_t t[10];
+	for(int i=0; i<10; i++) {
+		t[i] = Timer(100*(i+1), 100);
+		ASSERT(t[i]!=NOFILE);
+	}
+	for(int i=0; i<10; i++)
+		ASSERT(Read(t[i], (char*)&v, 8)==8 && v>=1);
+	for(int i=0; i<10; i++)
+		ASSERT(Close(t[i])==0);
+	return 0;
+}
+
+
 TEST_SUITE(socket_tests,
 	"A suite of tests for sockets."
 	)
@@ -1751,6 +3258,7 @@ TEST_SUITE(socket_tests,
 	&test_accept_reusable,
 	&test_accept_fails_on_exhausted_fid,
 	&test_accept_unblocks_on_close,
+	&test_accept_survives_closed_fid,
 
 	&test_connect_fails_on_bad_fid,
 	&test_connect_fails_on_bad_socket,
@@ -1761,6 +3269,14 @@ TEST_SUITE(socket_tests,
 	&test_socket_small_transfer,
 	&test_socket_single_producer,
 	&test_socket_multi_producer,
+	&test_socket_low_water,
+	&test_splice,
+	&test_message_queue,
+	&test_poll,
+	&test_event_set,
+	&test_nonblocking,
+	&test_event_counter,
+	&test_timer_stream,
 
 	&test_shudown_read,
 	&test_shudown_write,
@@ -1771,6 +3287,132 @@ TEST_SUITE(socket_tests,
 
 
 
+/*********************************************
+ *
+ *
+ *
+ *  System information tests
+ *
+ *
+ *
+ *********************************************/
+
+
+BOOT_TEST(test_openinfo_packs_records,
+	"Test that OpenInfo reports every used pid, packing as many records as fit in a Read"
+	)
+{
+	int child(int argl, void* args) {
+		return 0;
+	}
+
+	Pid_t children[10];
+	for(int i=0;i<10;i++)
+		ASSERT((children[i] = Exec(child, 0, NULL))!=NOPROC);
+
+	Fid_t finfo = OpenInfo();
+	ASSERT(finfo!=NOFILE);
+
+	/* Children are either alive or zombies, so the scheduler, init and 10 children are reported */
+	procinfo info[5];
+	int found = 0, total = 0, rc;
+	while((rc = Read(finfo, (char*) info, sizeof(info))) > 0) {
+		ASSERT(rc % sizeof(procinfo) == 0);
+		for(int j=0; j<rc/sizeof(procinfo); j++) {
+			total++;
+			for(int i=0;i<10;i++)
+				if(info[j].pid == children[i]) {
+					ASSERT(info[j].ppid == GetPid());
+					found++;
+				}
+		}
+	}
+	ASSERT(rc==0);
+	ASSERT(found==10);
+	ASSERT(total==12);
+
+	ASSERT(Read(finfo, (char*) info, sizeof(procinfo)-1)==-1);
+	ASSERT(Close(finfo)==0);
+
+	for(int i=0;i<10;i++)
+		ASSERT(WaitChild(children[i], NULL)==children[i]);
+	return 0;
+}
+
+
+BOOT_TEST(test_getrusage_accounts_children,
+	"Test that GetRusage accounts the I/O and threads of a process, and folds them into the parent when it is reaped"
+	)
+{
+	int task(int argl, void* args) {
+		return 0;
+	}
+
+	int child(int argl, void* args) {
+		pipe_t pipe;
+		char buffer[100] = { 0 };
+		ASSERT(Pipe(&pipe)==0);
+		ASSERT(Write(pipe.write, buffer, 100)==100);
+		ASSERT(Read(pipe.read, buffer, 100)==100);
+
+		Tid_t t1 = CreateThread(task, 0, NULL);
+		Tid_t t2 = CreateThread(task, 0, NULL);
+		ThreadJoin(t1, NULL);
+		ThreadJoin(t2, NULL);
+
+		rusage self;
+		ASSERT(GetRusage(RUSAGE_SELF, &self)==0);
+		ASSERT(self.bytes_written[STREAM_PIPE]==100);
+		ASSERT(self.bytes_read[STREAM_PIPE]==100);
+		ASSERT(self.peak_threads>=2);
+		ASSERT(self.syscalls>=8);
+		return 0;
+	}
+
+	rusage usage;
+	ASSERT(GetRusage(RUSAGE_SELF, NULL)==-1);
+	ASSERT(GetRusage(RUSAGE_CHILDREN, &usage)==0);
+	ASSERT(usage.syscalls==0);
+
+	for(int i=0;i<3;i++) {
+		Pid_t pid = Exec(child, 0, NULL);
+		ASSERT(WaitChild(pid, NULL)==pid);
+	}
+
+	ASSERT(GetRusage(RUSAGE_CHILDREN, &usage)==0);
+	ASSERT(usage.bytes_written[STREAM_PIPE]==300);
+	ASSERT(usage.bytes_read[STREAM_PIPE]==300);
+	ASSERT(usage.bytes_written[STREAM_SOCKET]==0);
+	ASSERT(usage.peak_threads>=2);
+	ASSERT(usage.syscalls>=24);
+
+	/* The last timeslice of a process is charged, even if it is its only one */
+	int spinner(int argl, void* args) {
+		volatile unsigned long count = 0;
+		while(count < 1000000) count++;
+		return 0;
+	}
+	unsigned long cpu_time = usage.cpu_time;
+	Pid_t pid = Exec(spinner, 0, NULL);
+	ASSERT(WaitChild(pid, NULL)==pid);
+	ASSERT(GetRusage(RUSAGE_CHILDREN, &usage)==0);
+	ASSERT(usage.cpu_time > cpu_time);
+	return 0;
+}
+
+
+TEST_SUITE(info_tests,
+	"A suite of tests for system information and resource accounting."
+	)
+{
+	&test_openinfo_packs_records,
+	&test_getrusage_accounts_children,
+	NULL
+};
+
+
+
+
 /*********************************************
  *
  *
@@ -2112,6 +3754,7 @@ TEST_SUITE(all_tests,
 	&thread_tests,
 	&pipe_tests,
 	&socket_tests,
+	&info_tests,
 	NULL
 };
 